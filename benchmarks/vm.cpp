@@ -1,6 +1,8 @@
 #include <benchmark/benchmark.h>
 #include <Ark/Ark.hpp>
 
+#include <variant>
+
 unsigned ack(unsigned m, unsigned n)
 {
     if (m > 0)
@@ -14,10 +16,27 @@ unsigned ack(unsigned m, unsigned n)
         return n + 1;
 }
 
+// the direct threaded dispatch is available only in the builds with -DARK_COMPUTED_GOTO=ON,
+// the dispatch benchmark compares it with the switch loop
+#ifdef ARK_USE_COMPUTED_GOTO
+    const char* dispatch_mode = "computed goto";
+#else
+    const char* dispatch_mode = "switch";
+#endif
+
+// same for the list backend, chosen with ARK_PERSISTENT_LISTS
+#ifdef ARK_PERSISTENT_LISTS
+    const char* list_backend = "persistent vector";
+#else
+    const char* list_backend = "std::vector";
+#endif
+
 // --------------------------------------------------
 
 static void Ackermann_3_6_ark(benchmark::State& state)
 {
+    state.SetLabel(dispatch_mode);
+
     while (state.KeepRunning())
     {
         Ark::VM vm;
@@ -28,6 +47,8 @@ static void Ackermann_3_6_ark(benchmark::State& state)
 
 static void Fibo_28_ark(benchmark::State& state)
 {
+    state.SetLabel(dispatch_mode);
+
     while (state.KeepRunning())
     {
         Ark::VM vm;
@@ -64,11 +85,631 @@ static void vm_boot(benchmark::State& state)
     }
 }
 
+// same as vm_boot, the bytecode being loaded once and shared by the VMs
+static void vm_boot_shared_program(benchmark::State& state)
+{
+    Ark::BytecodeReader bcr;
+    bcr.feed("tests/test-let.arkc");
+    auto program = std::make_shared<const Ark::Program>(bcr.bytecode());
+
+    while (state.KeepRunning())
+    {
+        Ark::VM vm;
+        vm.feed(program);
+    }
+}
+
+// a program declaring state.range(0) global symbols and calling a function 1000 times,
+// the cost of a call should not depend on the number of symbols
+static void calls_with_n_globals(benchmark::State& state)
+{
+    std::string code = "{\n";
+    for (int64_t i=0; i < state.range(0); ++i)
+        code += "(let global_" + std::to_string(i) + " " + std::to_string(i) + ")\n";
+    code += "(let foo (fun (a b) (+ a b)))\n"
+        "(mut i 0)\n"
+        "(while (< i 1000) (set i (foo i 1)))\n"
+        "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+    state.counters["symbols"] = state.range(0);
+}
+
+// allocations done by the VM while running ackermann(3, 6), the scopes being pooled
+// there should not be any allocation per call once the VM ran the code once
+static void ackermann_allocations(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(
+        "{\n"
+        "(let ackermann (fun (m n) {\n"
+        "    (if (> m 0)\n"
+        "        (if (= 0 n)\n"
+        "            (ackermann (- m 1) 1)\n"
+        "            (ackermann (- m 1) (ackermann m (- n 1))))\n"
+        "        (+ 1 n))}))\n"
+        "(ackermann 3 6)\n"
+        "}\n"
+    );
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+    vm.run();  // warm up the pools
+    Ark::AllocationCounters before = vm.allocationCounters();
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    const Ark::AllocationCounters& after = vm.allocationCounters();
+    double runs = static_cast<double>(state.iterations());
+    state.counters["calls"] = (after.calls - before.calls) / runs;
+    state.counters["scopes_allocated"] = (after.scopes_allocated - before.scopes_allocated) / runs;
+    state.counters["scopes_reused"] = (after.scopes_reused - before.scopes_reused) / runs;
+    state.counters["stack_grows"] = (after.stack_grows - before.stack_grows) / runs;
+    state.counters["frames_grows"] = (after.frames_grows - before.frames_grows) / runs;
+}
+
+const char* fibo_22_code =
+    "{\n"
+    "(let fibo (fun (n)\n"
+    "    (if (< n 2)\n"
+    "        n\n"
+    "        (+ (fibo (- n 1)) (fibo (- n 2))))))\n"
+    "(fibo 22)\n"
+    "}\n";
+
+// a loop of cheap instructions, where the time spent dispatching them dominates (fibo spends it in the calls),
+// run by the switch loop or by the direct threaded dispatch (state.range(0) = 0 or 1)
+static void dispatch(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(
+        "{(mut i 0) (mut s 0)\n"
+        "(while (< i 200000) {\n"
+        "    (set s (+ s (* i 2)))\n"
+        "    (set i (+ i 1)) })}\n"
+    );
+    compiler.compile();
+
+    Ark::VM vm(false, state.range(0) ? Ark::DefaultFeatures : (Ark::DefaultFeatures & ~Ark::FeatureComputedGoto));
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+#ifdef ARK_USE_COMPUTED_GOTO
+    state.SetLabel(state.range(0) ? "computed goto" : "switch");
+#else
+    state.SetLabel("switch, built without ARK_COMPUTED_GOTO");
+#endif
+}
+
+// fibo(22) with and without the superinstructions (state.range(0) = 0 or 1). Configure
+// with -DARK_PROFILER=ON to get the number of instructions dispatched per run
+static void superinstructions(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(fibo_22_code);
+    compiler.compile();
+
+    Ark::VM vm(false, Ark::FeatureComputedGoto | (state.range(0) ? Ark::FeatureSuperinstructions : 0));
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "fused" : "not fused");
+    state.counters["superinstructions"] = vm.superinstructionsCount();
+    state.counters["dispatches"] = vm.dispatchCount() / static_cast<double>(state.iterations());
+}
+
+// fibo(22) with and without the operators specialized for numbers (state.range(0) = 0 or 1)
+static void quickening(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(fibo_22_code);
+    compiler.compile();
+
+    Ark::VM vm(false, Ark::FeatureComputedGoto | (state.range(0) ? Ark::FeatureQuickening : 0));
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "quickened" : "generic");
+}
+
+// fibo(22) interpreted or compiled to native code by the JIT (state.range(0) = 0 or 1)
+static void jit(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(fibo_22_code);
+    compiler.compile();
+
+    Ark::VM vm(false, state.range(0) ? (Ark::DefaultFeatures | Ark::FeatureJIT) : Ark::DefaultFeatures);
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "jit" : "interpreted");
+    state.counters["native pages"] = vm.nativePagesCount();
+}
+
+// 256 calls of (fibo 15) given to a pool of state.range(0) VMs at each iteration,
+// the throughput should grow with the number of cores. The program has a global list of
+// 2^state.range(1) elements, which the VMs shouldn't copy when they are reset after each job
+static void vm_pool_throughput(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(
+        "{\n"
+        "(let fibo (fun (n) (if (< n 2) n (+ (fibo (- n 1)) (fibo (- n 2))))))\n"
+        "(mut numbers [0])\n"
+        "(mut i 0)\n"
+        "(while (< i " + std::to_string(state.range(1)) + ") { (set numbers (concat numbers numbers)) (set i (+ i 1)) })\n"
+        "}\n"
+    );
+    compiler.compile();
+
+    Ark::VMPool pool(std::make_shared<const Ark::Program>(compiler.bytecode()), state.range(0));
+    std::vector<std::future<Ark::internal::Value>> results;
+
+    while (state.KeepRunning())
+    {
+        for (int i=0; i < 256; ++i)
+            results.push_back(pool.call("fibo", { Ark::internal::Value(15) }));
+        for (auto& result : results)
+            benchmark::DoNotOptimize(result.get());
+        results.clear();
+    }
+
+    state.SetItemsProcessed(state.iterations() * 256);
+    state.counters["globals"] = 1 << state.range(1);
+}
+
+// (fibo 15) on each element of a list of 256 numbers, with a while loop (state.range(0) = 0)
+// or with pmap (state.range(0) = 1), which uses a thread per core
+static void pmap_vs_while(benchmark::State& state)
+{
+    std::string code =
+        "{\n"
+        "(let fibo (fun (n) (if (< n 2) n (+ (fibo (- n 1)) (fibo (- n 2))))))\n"
+        "(mut numbers [])\n"
+        "(mut i 0)\n"
+        "(while (< i 256) { (set numbers (append numbers 15)) (set i (+ i 1)) })\n";
+    if (state.range(0))
+        code += "(let output (pmap numbers fibo))\n";
+    else
+        code +=
+            "(mut output [])\n"
+            "(set i 0)\n"
+            "(while (< i 256) { (set output (append output (fibo (@ numbers i)))) (set i (+ i 1)) })\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "pmap" : "while");
+    state.counters["threads"] = state.range(0) ? std::thread::hardware_concurrency() : 1;
+}
+
+static void budgeted_run(benchmark::State& state)
+{
+    Ark::Compiler compiler;
+    compiler.feed(
+        "{\n"
+        "(let fibo (fun (n) (if (< n 2) n (+ (fibo (- n 1)) (fibo (- n 2))))))\n"
+        "(let a (fibo 22))\n"
+        "}\n"
+    );
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    const std::size_t budget = state.range(0);
+    std::size_t slices = 0;
+
+    while (state.KeepRunning())
+    {
+        if (budget == 0)
+            vm.run();
+        else
+        {
+            // resuming until the end, as a scheduler giving a time slice to the VM would
+            Ark::RunState run_state = vm.start(budget);
+            for (; run_state != Ark::RunState::Finished; ++slices)
+                run_state = vm.resume(budget);
+        }
+    }
+
+    state.SetLabel(budget == 0 ? "run" : "start/resume");
+    state.counters["slices"] = benchmark::Counter(slices, benchmark::Counter::kAvgIterations);
+}
+
+static void generator_vs_closure_range(benchmark::State& state)
+{
+    std::string code = "{\n";
+    if (state.range(0))
+        code +=
+            "(let range (fun (a b) {\n"
+            "    (mut i a)\n"
+            "    (while (< i b) { (yield i) (set i (+ i 1)) })\n"
+            "}))\n";
+    else
+        // lib/Range.ark
+        code +=
+            "(let range (fun (a b)\n"
+            "    (fun (&a &b) {\n"
+            "        (if (< a b) { (mut c a) (set a (+ a 1)) c } nil)\n"
+            "    })))\n";
+    code +=
+        "(let r (range 0 100000))\n"
+        "(mut sum 0)\n"
+        "(mut x (r))\n"
+        "(while (!= x nil) { (set sum (+ sum x)) (set x (r)) })\n"
+        "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "generator" : "closure (Range.ark)");
+    state.counters["scopes_allocated"] = vm.allocationCounters().scopes_allocated;
+}
+
+static void closure_cycles(benchmark::State& state)
+{
+    // each closure is stored in the scope it captured when cyclic is true
+    Ark::Compiler compiler;
+    compiler.feed(
+        "{\n"
+        "(let cyclic " + std::string(state.range(0) ? "true" : "false") + ")\n"
+        "(let make (fun () {\n"
+        "    (mut self nil)\n"
+        "    (mut c (fun (v &self) (set self v)))\n"
+        "    (if cyclic (c c) (c 1))\n"
+        "    nil\n"
+        "}))\n"
+        "(mut i 0)\n"
+        "(while (< i 20000) { (make) (set i (+ i 1)) })\n"
+        "}\n"
+    );
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) ? "cycles" : "no cycles");
+    state.counters["scopes_reclaimed"] = benchmark::Counter(vm.allocationCounters().scopes_reclaimed, benchmark::Counter::kAvgIterations);
+    state.counters["collections"] = benchmark::Counter(vm.allocationCounters().cycle_collections, benchmark::Counter::kAvgIterations);
+}
+
+static void closure_examples(benchmark::State& state)
+{
+    std::string code = "{\n";
+    if (state.range(0) == 0)
+        // examples/closure.ark
+        code +=
+            "(let countdown-from (fun (number)\n"
+            "    (fun (&number) { (set number (- number 1)) number })))\n"
+            "(let run (fun () {\n"
+            "    (let c (countdown-from 3))\n"
+            "    (c) (c) (c)\n"
+            "}))\n"
+            "(mut i 0)\n"
+            "(while (< i 20000) { (run) (set i (+ i 1)) })\n";
+    else
+        // examples/church-encoding.ark
+        code +=
+            "(let create-human (fun (name age weight) {\n"
+            "    (let set-age (fun (new-age) (set age new-age)))\n"
+            "    (fun (&set-age &name &age &weight) ())\n"
+            "}))\n"
+            "(let run (fun () {\n"
+            "    (let bob (create-human \"Bob\" 0 144))\n"
+            "    (bob.set-age 10)\n"
+            "    bob.age\n"
+            "}))\n"
+            "(mut i 0)\n"
+            "(while (< i 20000) { (run) (set i (+ i 1)) })\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) == 0 ? "closure.ark" : "church-encoding.ark");
+}
+
+static void big_lists(benchmark::State& state)
+{
+    // a list of 2^17 elements for the loads, a smaller one used as a queue
+    std::string code =
+        "{\n"
+        "(mut l (list 0))\n"
+        "(mut k 0)\n"
+        "(while (< k " + std::string(state.range(0) == 2 ? "13" : "17") + ") { (set l (concat l l)) (set k (+ k 1)) })\n"
+        "(mut i 0)\n";
+    if (state.range(0) == 0)
+        code +=
+            "(let f (fun (x) (len x)))\n"
+            "(while (< i 10000) { (f l) (set i (+ i 1)) })\n";
+    else if (state.range(0) == 1)
+        code +=
+            "(mut sum 0)\n"
+            "(while (< i 10000) { (set sum (+ sum (@ l i))) (set i (+ i 1)) })\n";
+    else
+        code +=
+            "(while (< i 2000) { (set l (append (tailOf l) i)) (set i (+ i 1)) })\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    const char* labels[] = { "list given to a function", "list read in a loop", "list used as a queue" };
+    state.SetLabel(labels[state.range(0)]);
+}
+
+static void functional_lists(benchmark::State& state)
+{
+    std::string code =
+        "{\n"
+        "(mut l (list 0))\n"
+        "(mut k 0)\n"
+        "(while (< k 13) { (set l (concat l l)) (set k (+ k 1)) })\n";
+    if (state.range(0) == 0)
+        code +=
+            "(let sum (fun (x acc) (if (nil? x) acc (sum (tailOf x) (+ acc (firstOf x))))))\n"
+            "(sum l 0)\n";
+    else if (state.range(0) == 1)
+        code +=
+            "(let count (fun (x acc) (if (nil? x) acc (count (headOf x) (+ acc 1)))))\n"
+            "(count l 0)\n";
+    else if (state.range(0) == 2)
+        code +=
+            "(mut m (list))\n"
+            "(mut i 0)\n"
+            "(while (< i 8192) { (set m (append m i)) (set i (+ i 1)) })\n";
+    else
+        code +=
+            "(mut sum 0)\n"
+            "(mut i 0)\n"
+            "(while (< i 8192) { (set sum (+ sum (@ l i))) (set i (+ i 1)) })\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    const char* labels[] = { "tailOf recursion", "headOf recursion", "append in a loop", "@ in a loop" };
+    state.SetLabel(std::string(labels[state.range(0)]) + ", " + list_backend);
+}
+
+static void string_walk(benchmark::State& state)
+{
+    // a string of 2^16 characters, walked character by character
+    std::string code =
+        "{\n"
+        "(mut s \"a\")\n"
+        "(mut k 0)\n"
+        "(while (< k 16) { (set s (+ s s)) (set k (+ k 1)) })\n"
+        "(mut count 0)\n";
+    if (state.range(0) == 0)
+        code +=
+            "(while (= false (nil? s)) { (if (= \"a\" (firstOf s)) (set count (+ count 1)) ()) (set s (tailOf s)) })\n";
+    else if (state.range(0) == 1)
+        code +=
+            "(while (= false (nil? s)) { (set count (+ count 1)) (set s (headOf s)) })\n";
+    else
+        code +=
+            "(mut i 0)\n"
+            "(while (< i (len s)) { (if (= \"a\" (@ s i)) (set count (+ count 1)) ()) (set i (+ i 1)) })\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    const char* labels[] = { "firstOf and tailOf", "headOf", "@" };
+    state.SetLabel(labels[state.range(0)]);
+}
+
+static void string_building(benchmark::State& state)
+{
+    std::string code =
+        "{\n"
+        "(mut i 0)\n";
+    if (state.range(0) == 0)
+        code +=
+            "(mut s \"\")\n"
+            "(while (< i 20000) { (set s (+ s (+ \"line \" (toString i)))) (set i (+ i 1)) })\n"
+            "(len s)\n";
+    else
+        code +=
+            "(let sb (stringBuilder))\n"
+            "(while (< i 20000) { (builderAppendNumber (builderAppend sb \"line \") i) (set i (+ i 1)) })\n"
+            "(len (builderFinish sb))\n";
+    code += "}\n";
+
+    Ark::Compiler compiler;
+    compiler.feed(code);
+    compiler.compile();
+
+    Ark::VM vm;
+    vm.feed(compiler.bytecode());
+
+    while (state.KeepRunning())
+    {
+        vm.run();
+    }
+
+    state.SetLabel(state.range(0) == 0 ? "(set s (+ s piece))" : "string builder");
+}
+
+// --------------------------------------------------
+
+using namespace Ark::internal;
+
+// layout of a Value before it was made compact, kept to compare with the current one
+struct LegacyValue
+{
+    std::variant<double, std::string, PageAddr_t, NFT, Value::ProcType, Closure, std::vector<Value>> value;
+    ValueType type;
+    bool is_const;
+};
+
+static void value_copy_number(benchmark::State& state)
+{
+    Value v(42);
+
+    while (state.KeepRunning())
+    {
+        Value copy(v);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.counters["sizeof"] = sizeof(Value);
+}
+
+static void value_copy_list(benchmark::State& state)
+{
+    Value v(std::vector<Value>(state.range(0), Value(42)));
+
+    while (state.KeepRunning())
+    {
+        Value copy(v);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.counters["sizeof"] = sizeof(Value);
+}
+
+static void legacy_value_copy_number(benchmark::State& state)
+{
+    LegacyValue v { 42.0, ValueType::Number, false };
+
+    while (state.KeepRunning())
+    {
+        LegacyValue copy(v);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.counters["sizeof"] = sizeof(LegacyValue);
+}
+
+static void legacy_value_copy_list(benchmark::State& state)
+{
+    LegacyValue v { std::vector<Value>(state.range(0), Value(42)), ValueType::List, false };
+
+    while (state.KeepRunning())
+    {
+        LegacyValue copy(v);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.counters["sizeof"] = sizeof(LegacyValue);
+}
+
 BENCHMARK(Ackermann_3_6_ark)->Unit(benchmark::kMillisecond);
 BENCHMARK(Fibo_28_ark)->Unit(benchmark::kMillisecond);
 BENCHMARK(Ackermann_3_6_cpp)->Unit(benchmark::kMillisecond);
 BENCHMARK(let_a_42)->Unit(benchmark::kNanosecond);
 BENCHMARK(vm_boot)->Unit(benchmark::kNanosecond);
+BENCHMARK(vm_boot_shared_program)->Unit(benchmark::kNanosecond);
+BENCHMARK(ackermann_allocations)->Unit(benchmark::kMillisecond);
+BENCHMARK(dispatch)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(superinstructions)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(quickening)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(jit)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(vm_pool_throughput)->Args({1, 0})->Args({2, 0})->Args({4, 0})->Args({8, 0})->Args({1, 17})->Args({8, 17})->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(pmap_vs_while)->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(generator_vs_closure_range)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(closure_examples)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(big_lists)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+BENCHMARK(functional_lists)->DenseRange(0, 3)->Unit(benchmark::kMillisecond);
+BENCHMARK(string_walk)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(string_building)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(closure_cycles)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(budgeted_run)->Arg(0)->Arg(100)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(calls_with_n_globals)->RangeMultiplier(8)->Range(8, 4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(value_copy_number)->Unit(benchmark::kNanosecond);
+BENCHMARK(legacy_value_copy_number)->Unit(benchmark::kNanosecond);
+BENCHMARK(value_copy_list)->Arg(1000)->Unit(benchmark::kNanosecond);
+BENCHMARK(legacy_value_copy_list)->Arg(1000)->Unit(benchmark::kNanosecond);
 
 int main(int argc, char** argv)
 {
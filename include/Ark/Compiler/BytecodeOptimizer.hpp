@@ -0,0 +1,84 @@
+#ifndef ark_compiler_bytecodeoptimizer
+#define ark_compiler_bytecodeoptimizer
+
+#include <vector>
+#include <string>
+#include <cinttypes>
+
+#include <Ark/Compiler/BytecodeReader.hpp>
+#include <Ark/VM/Types.hpp>
+
+namespace Ark
+{
+    /*
+        Peephole optimizations on compiled bytecode, used by ark-opt:
+            - jumps to a JUMP go directly to its target, jumps to the next instruction are removed
+            - NOP and unreachable instructions are removed
+            - the constants which aren't loaded anymore are removed from the constants table
+        The symbols table is kept as is, the VM can look for the symbols by name
+    */
+    class BytecodeOptimizer
+    {
+    public:
+        struct Stats
+        {
+            std::size_t jumps_threaded = 0;
+            std::size_t jumps_removed = 0;
+            std::size_t nops_removed = 0;
+            std::size_t unreachable_removed = 0;
+            std::size_t constants_removed = 0;
+        };
+
+        BytecodeOptimizer();
+
+        void feed(const bytecode_t& bytecode);
+        void optimize();
+
+        const bytecode_t& bytecode() const;
+        const Stats& stats() const;
+
+    private:
+        // an instruction with its operand, and its address in the original page
+        struct Record
+        {
+            uint8_t inst;
+            uint16_t arg;
+            uint16_t address;
+            bool removed;
+        };
+
+        struct Segment
+        {
+            std::vector<uint16_t> layout;
+            std::vector<Record> code;
+            uint16_t size;  // in bytes
+        };
+
+        bytecode_t m_bytecode;
+        Stats m_stats;
+
+        // parts of the bytecode which are written back without being modified
+        bytecode_t m_header;  // magic constant, version, timestamp
+        bytecode_t m_symbols;
+        bytecode_t m_plugins;
+        std::vector<bytecode_t> m_constants;  // each value with its type and its terminating NOP
+        std::vector<Segment> m_segments;
+
+        void threadJumps(Segment& segment);
+        void removeUnreachable(Segment& segment);
+        void removeNops(Segment& segment);
+        void compactConstants();
+        // give their new address to the instructions kept, and update the jumps
+        void relocate(Segment& segment);
+
+        // index of the instruction at the given address, the size of the code if there isn't any
+        static std::size_t indexOf(const Segment& segment, uint16_t address);
+
+        void write();
+        void pushNumber(uint16_t n);
+        uint16_t readNumber(const bytecode_t& b, std::size_t& i);
+        void throwOptimizerError(const std::string& message);
+    };
+}
+
+#endif
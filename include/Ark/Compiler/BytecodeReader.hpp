@@ -6,6 +6,7 @@
 #include <iostream>
 #include <string>
 #include <cinttypes>
+#include <map>
 
 namespace Ark
 {
@@ -21,7 +22,15 @@ namespace Ark
 
         unsigned long long timestamp();
 
+        // true if the bytecode was generated by a compiler of the same major and minor version
+        // as this one, the format being changed only by the minor versions
+        bool compatible();
+
         void display();
+
+        // count the sequences of 2 and 3 instructions in the code segments, to find which ones
+        // are worth fusing into superinstructions. The counts are added to the given maps
+        void countSequences(std::map<std::string, std::size_t>& pairs, std::map<std::string, std::size_t>& triples);
     
     private:
         bytecode_t m_bytecode;
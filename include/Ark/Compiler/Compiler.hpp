@@ -6,9 +6,12 @@
 #include <string>
 #include <cinttypes>
 #include <optional>
+#include <unordered_set>
+#include <unordered_map>
 
 #include <Ark/Parser/Parser.hpp>
 #include <Ark/Parser/Node.hpp>
+#include <Ark/Compiler/Optimizer.hpp>
 #include <Ark/Compiler/Value.hpp>
 #include <Ark/Compiler/Instructions.hpp>
 #include <Ark/Compiler/BytecodeReader.hpp>
@@ -19,7 +22,8 @@ namespace Ark
     class Compiler
     {
     public:
-        Compiler(bool debug=false);
+        // optimize: evaluate at compile time what can be (constants, conditions), see Optimizer
+        Compiler(bool debug=false, bool optimize=true);
 
         void feed(const std::string& code, const std::string& filename="FILE");
         void compile();
@@ -27,17 +31,31 @@ namespace Ark
 
         const bytecode_t& bytecode();
 
+        // number of instructions the optimizer saved in each code segment, by page id (empty when it's disabled)
+        const std::vector<std::size_t>& savedInstructions() const;
+
     private:
         Ark::Parser m_parser;
+        internal::Optimizer m_optimizer;
         std::vector<std::string> m_symbols;
         std::vector<internal::CValue> m_values;
         std::vector<std::string> m_plugins;
         std::vector<std::vector<internal::Inst>> m_code_pages;
         std::vector<std::vector<internal::Inst>> m_temp_pages;
+        std::vector<std::size_t> m_temp_pages_owner;
+
+        // lexical addressing
+        std::vector<std::unordered_set<std::string>> m_page_locals;  // symbols declared by each page
+        std::unordered_map<std::size_t, std::unordered_set<std::string>> m_page_captures;  // symbols captured by the closures, by page
+        std::unordered_set<std::string> m_globals;  // symbols declared only in the global scope
+        std::unordered_set<std::string> m_dynamic_symbols;  // symbols searched for at runtime
+        std::vector<std::pair<std::size_t, std::size_t>> m_tail_calls;  // (page, position) of the TAIL_CALL
+        std::unordered_set<std::size_t> m_generator_pages;  // pages which are the body of a generator
 
         bytecode_t m_bytecode;
 
         bool m_debug;
+        bool m_optimize;
         bool m_ast_ok;
 
         inline std::vector<internal::Inst>& page(int i)
@@ -47,6 +65,13 @@ namespace Ark
             return m_temp_pages[-i - 1];
         }
 
+        inline std::size_t realPage(int i)
+        {
+            if (i >= 0)
+                return static_cast<std::size_t>(i);
+            return m_temp_pages_owner[-i - 1];
+        }
+
         inline std::optional<std::size_t> isOperator(const std::string& name)
         {
             auto it = std::find(internal::FFI::operators.begin(), internal::FFI::operators.end(), name);
@@ -66,7 +91,11 @@ namespace Ark
             return {};
         }
 
-        void _compile(Ark::internal::Node x, int p);
+        void _compile(Ark::internal::Node x, int p, bool is_terminal=false);
+        void collectBindings(const Ark::internal::Node& x, bool in_function, std::unordered_set<std::string>& globals, std::unordered_set<std::string>& locals);
+        void collectLocals(const Ark::internal::Node& x, std::unordered_set<std::string>& locals);
+        // a function body yielding values, without counting the functions declared in it
+        bool isGenerator(const Ark::internal::Node& x);
         std::size_t addSymbol(const std::string& sym);
         std::size_t addValue(Ark::internal::Node x);
         std::size_t addValue(std::size_t page_id);
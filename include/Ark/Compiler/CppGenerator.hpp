@@ -0,0 +1,50 @@
+#ifndef ark_compiler_cppgenerator
+#define ark_compiler_cppgenerator
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cinttypes>
+
+#include <Ark/Compiler/BytecodeReader.hpp>
+#include <Ark/VM/Types.hpp>
+
+namespace Ark
+{
+    /*
+        Generates a C++ translation unit running bytecode, used by ark-aot. Each code page, as
+        decoded by the VM, becomes a function running its instructions with the handlers of the
+        VM, the jumps being gotos. The bytecode is embedded in the generated code: the VM is fed
+        with it, then runs the generated functions instead of interpreting the pages
+    */
+    class CppGenerator
+    {
+    public:
+        CppGenerator();
+
+        // source: file the bytecode comes from, written in the generated code
+        void feed(const bytecode_t& bytecode, const std::string& source);
+        // plugin: generate a plugin giving the functions declared in the global scope of the
+        // script to the VM loading it, instead of a program running the script
+        void generate(bool plugin=false);
+
+        const std::string& code() const;
+        // names of the functions given by the plugin
+        const std::vector<std::string>& exportedFunctions() const;
+
+    private:
+        bytecode_t m_bytecode;
+        std::string m_source;
+        std::string m_code;
+        std::vector<std::string> m_exported;
+
+        void generateBytecode(std::ostream& os);
+        void generatePage(std::ostream& os, const std::vector<internal::DecodedInst>& page, std::size_t pp);
+        void generateProgram(std::ostream& os);
+        void generatePlugin(std::ostream& os);
+
+        static std::string escape(const std::string& str);
+    };
+}
+
+#endif
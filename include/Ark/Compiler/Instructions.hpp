@@ -33,7 +33,13 @@ namespace Ark::internal
             DEL = 0x0e,
             SAVE_ENV = 0x0f,
             GET_FIELD = 0x10,
-        LAST_COMMAND = 0x10,
+            LOAD_LOCAL = 0x11,
+            STORE_LOCAL = 0x12,
+            LOAD_GLOBAL = 0x13,
+            TAIL_CALL = 0x14,
+            GENERATOR = 0x15,
+            YIELD = 0x16,
+        LAST_COMMAND = 0x16,
 
         FIRST_OPERATOR = 0x20,
             ADD = 0x20,
@@ -61,7 +67,44 @@ namespace Ark::internal
             MOD  = 0x36,
             TYPE = 0x37,
             HASFIELD = 0x38,
-        LAST_OPERATOR = 0x38,
+            PMAP = 0x39,
+            PFOREACH = 0x3a,
+        LAST_OPERATOR = 0x3a,
+
+        // superinstructions, never found in a bytecode file: the VM creates them when
+        // loading the bytecode, by fusing the most frequent sequences of instructions
+        FIRST_SUPERINSTRUCTION = 0x40,
+            LOAD_LOCAL_LOAD_CONST_ADD = 0x40,
+            LOAD_LOCAL_LOAD_CONST_SUB = 0x41,
+            LOAD_LOCAL_LOAD_CONST_MUL = 0x42,
+            LOAD_LOCAL_LOAD_CONST_DIV = 0x43,
+            LOAD_LOCAL_LOAD_CONST_GT  = 0x44,
+            LOAD_LOCAL_LOAD_CONST_LT  = 0x45,
+            LOAD_LOCAL_LOAD_CONST_LE  = 0x46,
+            LOAD_LOCAL_LOAD_CONST_GE  = 0x47,
+            LOAD_LOCAL_LOAD_CONST_NEQ = 0x48,
+            LOAD_LOCAL_LOAD_CONST_EQ  = 0x49,
+            LOAD_GLOBAL_CALL = 0x4a,
+            LOAD_GLOBAL_TAIL_CALL = 0x4b,
+            LOAD_LOCAL_CALL = 0x4c,
+            BUILTIN_CALL = 0x4d,
+        LAST_SUPERINSTRUCTION = 0x4d,
+
+        // quickened instructions, never found in a bytecode file either: after running an
+        // operator on numbers, the VM replaces it by its variant for numbers, which goes back
+        // to the generic operator when given something else
+        FIRST_QUICKENED = 0x50,
+            ADD_NUM = 0x50,
+            SUB_NUM = 0x51,
+            MUL_NUM = 0x52,
+            DIV_NUM = 0x53,
+            GT_NUM  = 0x54,
+            LT_NUM  = 0x55,
+            LE_NUM  = 0x56,
+            GE_NUM  = 0x57,
+            NEQ_NUM = 0x58,
+            EQ_NUM  = 0x59,
+        LAST_QUICKENED = 0x59,
 
         LAST_INSTRUCTION = 0x36
     };
@@ -0,0 +1,55 @@
+#ifndef ark_compiler_optimizer
+#define ark_compiler_optimizer
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Ark/Parser/Node.hpp>
+
+namespace Ark::internal
+{
+    /*
+        Optimizes the AST given by the parser, before generating the bytecode:
+            - operators applied to literals are evaluated
+            - the symbols declared once, with let, in the global scope, are replaced
+              by their value when it's a literal, in the code following their declaration
+            - conditions known at compile time are replaced by the branch taken
+    */
+    class Optimizer
+    {
+    public:
+        Optimizer(bool debug=false);
+
+        void feed(const Node& ast);
+        const Node& ast() const;
+
+        // number of instructions saved in each code segment, by page id
+        const std::vector<std::size_t>& savedInstructions() const;
+
+    private:
+        bool m_debug;
+        Node m_ast;
+
+        std::unordered_map<std::string, unsigned> m_declarations;  // number of declarations of each symbol
+        std::unordered_set<std::string> m_modified;  // symbols used with set or del
+        std::unordered_map<std::string, Node> m_constants;  // symbols replaced by their value
+        std::vector<std::size_t> m_saved;
+
+        void countDeclarations(const Node& x);
+        // straight: the node is always run, and in order with its siblings (global scope only)
+        void optimize(Node& x, std::size_t page, bool straight);
+
+        std::optional<Node> fold(const Node& x);
+        std::optional<Node> fold(const std::string& op, const Node& a, const Node& b);
+        std::optional<bool> condition(const Node& x);
+
+        // estimate of the instructions generated by the compiler in the page of the node
+        std::size_t instructionsCount(const Node& x);
+        void registerSaved(std::size_t page, std::size_t before, std::size_t after);
+    };
+}
+
+#endif
@@ -50,7 +50,7 @@ namespace Ark::internal
     
     const std::vector<std::string> keywords = {
         "if", "let", "mut", "set", "fun", "while",
-        "begin", "import", "quote", "del"
+        "begin", "import", "quote", "del", "yield"
     };
 
     const std::vector<std::pair<TokenType, std::regex>> lex_regexes = {
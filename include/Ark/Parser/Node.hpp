@@ -34,7 +34,8 @@ namespace Ark::internal
         Begin,
         Import,
         Quote,
-        Del
+        Del,
+        Yield
     };
 
     class Node
@@ -1,16 +1,17 @@
 #ifndef ark_vm_closure
 #define ark_vm_closure
 
-#include <memory>
 #include <vector>
 
 #include <Ark/VM/Types.hpp>
+#include <Ark/VM/Ref.hpp>
 
 namespace Ark::internal
 {
     class Value;
+    class Scope;
 
-    using Scope_t = std::shared_ptr<std::vector<Value>>;
+    using Scope_t = Ref<Scope>;
 
     class Closure
     {
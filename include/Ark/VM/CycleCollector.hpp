@@ -0,0 +1,57 @@
+#ifndef ark_vm_cyclecollector
+#define ark_vm_cyclecollector
+
+#include <vector>
+#include <cinttypes>
+
+#include <Ark/VM/Value.hpp>
+#include <Ark/VM/Scope.hpp>
+#include <Ark/Constants.hpp>
+
+namespace Ark::internal
+{
+    /*
+        Frees the scopes which are only referenced by cycles, for example a closure stored in the
+        scope it captured, which the refcounting of the scopes and of the boxes can't free.
+        The VM tracks the scopes captured by closures and generators, the only ones which can be
+        part of a cycle, and collect() runs a trial deletion on the graph reachable from them: the
+        references between the objects of the graph are subtracted from their refcounts, the objects
+        still referenced from outside of the graph (the stack, the frames, the host...) being alive
+        with everything they reach. The others are garbage, their scopes are cleared to break the cycles.
+        Each VM has its own collector, the pmap workers included: they work on deep copies of the values
+    */
+    class CycleCollector
+    {
+    public:
+        CycleCollector();
+
+        // remember a scope which can be part of a cycle
+        inline void track(const Scope_t& scope)
+        {
+            m_candidates.emplace_back(scope);
+        }
+
+        // enough scopes were tracked since the last collection to look for cycles
+        inline bool full() const
+        {
+            return m_candidates.size() >= m_threshold;
+        }
+
+        // returns the number of scopes freed
+        std::size_t collect();
+
+    private:
+        std::vector<WeakRef<Scope>> m_candidates;
+        std::size_t m_threshold;
+
+        // give each value and each scope referenced by an object (a scope, or the box of a value)
+        // to the callbacks
+        template <typename OnValue, typename OnScope>
+        static void forEachChild(Scope* scope, const Value* value, OnValue&& on_value, OnScope&& on_scope);
+
+        // the box of the value, if it can reference other objects
+        static const BoxBase* boxOf(const Value& value);
+    };
+}
+
+#endif
@@ -34,6 +34,16 @@ namespace Ark::internal::FFI
     FFI_Function(readFile);    // readFile, 1 argument
     FFI_Function(fileExists);  // fileExists?, 1 argument
     FFI_Function(timeSinceEpoch);  // time, 0 argument
+    FFI_Function(yieldToHost);  // yieldToHost, 0 argument, pauses the VM when it's run by VM::start
+    FFI_Function(stringBuilder);        // stringBuilder, 0 or 1 argument
+    FFI_Function(builderAppend);        // builderAppend, multiple arguments
+    FFI_Function(builderAppendNumber);  // builderAppendNumber, multiple arguments
+    FFI_Function(builderFinish);        // builderFinish, 1 argument
+
+    // append and concat for the VM, which throws the arguments away after the call: the first
+    // one is moved from, its list being extended in place when nothing else references it
+    Value appendInPlace(std::vector<Value>& n);
+    Value concatInPlace(std::vector<Value>& n);
 }
 
 #undef FFI_Function
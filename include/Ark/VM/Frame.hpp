@@ -14,7 +14,7 @@ namespace Ark::internal
 {
     /*
         A frame should hold:
-        - its own stack
+        - the position of its window in the stack of the VM
         - a return address to a possible caller (if it's a function's frame)
     */
     class Frame
@@ -22,39 +22,14 @@ namespace Ark::internal
     public:
         Frame();
         Frame(const Frame&) = default;
-        Frame(std::size_t caller_addr, std::size_t caller_page_addr, std::size_t new_pp);
-
-        // stack related
-
-        inline Value&& pop()
-        {
-            m_i--;
-            return std::move(m_stack[m_i]);
-        }
-
-        inline void push(const Value& value)
-        {
-            m_stack[m_i] = value;
-            m_i++;
-
-            if (m_i == m_stack.size())
-                m_stack.emplace_back();
-        }
-
-        inline void push(Value&& value)
-        {
-            m_stack[m_i] = std::move(value);
-            m_i++;
-
-            if (m_i == m_stack.size())
-                m_stack.emplace_back();
-        }
+        Frame(std::size_t caller_addr, std::size_t caller_page_addr, std::size_t new_pp, std::size_t stack_base);
 
         // getters-setters (misc)
 
-        inline std::size_t stackSize() const
+        // index of the first value of the frame in the stack of the VM
+        inline std::size_t stackBase() const
         {
-            return m_i;
+            return m_stack_base;
         }
 
         inline std::size_t callerAddr() const
@@ -95,8 +70,7 @@ namespace Ark::internal
         //              IP,          PP    EXC_PP
         std::size_t m_addr, m_page_addr, m_new_pp;
 
-        std::vector<Value> m_stack;
-        int16_t m_i;
+        std::size_t m_stack_base;
 
         uint8_t m_scope_to_delete;
     };
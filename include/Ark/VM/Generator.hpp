@@ -0,0 +1,96 @@
+#ifndef ark_vm_generator
+#define ark_vm_generator
+
+#include <vector>
+#include <cinttypes>
+
+#include <Ark/VM/Types.hpp>
+#include <Ark/VM/Closure.hpp>
+
+namespace Ark::internal
+{
+    class Value;
+
+    /*
+        A function suspended by YIELD: the scopes of its frame (the one captured by the closure
+        if any, then the one of the function), its own stack and the instruction to resume from.
+        The VM runs the generator on its stack, swapping it with the stack of the caller, thus
+        yielding and resuming don't depend on the number of values the function left on it
+    */
+    class Generator
+    {
+    public:
+        enum class State
+        {
+            Suspended,  // created, or stopped by a YIELD
+            Running,
+            Finished    // the function returned, the generator gives nil from now on
+        };
+
+        Generator(std::vector<Scope_t>&& scopes, PageAddr_t pa, std::size_t ip);
+
+        inline const std::vector<Scope_t>& scopes() const
+        {
+            return m_scopes;
+        }
+
+        // swapped with the stack of the VM while the generator runs
+        inline std::vector<Value>& stack()
+        {
+            return m_stack;
+        }
+
+        // number of values in its stack
+        inline std::size_t sp() const
+        {
+            return m_sp;
+        }
+
+        // number of values in the stack of the caller, given back to it when leaving the generator
+        inline std::size_t callerSp() const
+        {
+            return m_caller_sp;
+        }
+
+        inline PageAddr_t pageAddr() const
+        {
+            return m_page_addr;
+        }
+
+        inline std::size_t ip() const
+        {
+            return m_ip;
+        }
+
+        inline State state() const
+        {
+            return m_state;
+        }
+
+        // false until the function yielded once
+        inline bool started() const
+        {
+            return m_started;
+        }
+
+        void resume(std::size_t caller_sp);
+        // ip: instruction following the YIELD
+        void suspend(std::size_t ip, std::size_t sp);
+        // drop the scopes and the stack, which aren't needed anymore
+        void finish();
+
+    private:
+        friend class Transfer;
+
+        std::vector<Scope_t> m_scopes;
+        std::vector<Value> m_stack;
+        std::size_t m_sp;
+        std::size_t m_caller_sp;
+        PageAddr_t m_page_addr;
+        std::size_t m_ip;
+        State m_state;
+        bool m_started;
+    };
+}
+
+#endif
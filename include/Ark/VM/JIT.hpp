@@ -0,0 +1,179 @@
+#ifndef ark_vm_jit
+#define ark_vm_jit
+
+#include <vector>
+#include <cinttypes>
+#include <cstddef>
+#include <utility>
+#include <initializer_list>
+
+// the JIT generates x86-64 code, and allocates the executable memory with mmap
+#if defined(__x86_64__) && defined(__linux__)
+    #define ARK_JIT_AVAILABLE
+#endif
+
+namespace Ark::internal
+{
+    // runs an instruction for the native code: VM, index of the instruction, page being run.
+    // Returns the index of the next instruction to run in this page, -1 to go back to the VM
+    using NativeHelper = int (*)(void* vm, int ip, int page);
+    // entry point of the native code of a page: VM, index of the first instruction to run
+    using NativeFunction = int (*)(void* vm, int ip);
+
+    // the bytes of a value which isn't boxed, written as is by the native code
+    struct NativeValue
+    {
+        uint64_t payload;
+        uint64_t tag;  // type, constness
+    };
+
+    // what the instructions inlined in the native code know of the VM: the offsets in the VM of the
+    // data they read and write, and the layout of the values
+    struct NativeLayout
+    {
+        int32_t ip;         // int
+        int32_t sp;         // std::size_t
+        int32_t fp;         // std::size_t
+        int32_t last_sym;   // uint16_t
+        int32_t stack;      // Value*, the first value of the stack
+        int32_t stack_size; // std::size_t
+        int32_t locals;     // (uint16_t, Value) pairs, the slots of the current scope
+        int32_t slot_size;  // size of a pair
+        int32_t slot_value; // offset of the value in a pair
+        uint8_t number_type;
+        uint32_t unboxed_types;  // bit n is set if the values of type n aren't boxed
+    };
+
+    enum class NativeOperator
+    {
+        Add, Sub, Mul, Div,
+        Gt, Lt, Le, Ge, Neq, Eq
+    };
+
+    // executable memory holding the native code of a page
+    class NativeCode
+    {
+    public:
+        NativeCode();
+        // code which isn't generated by the JIT, the memory isn't owned
+        explicit NativeCode(NativeFunction function);
+        ~NativeCode();
+
+        NativeCode(const NativeCode&) = delete;
+        NativeCode& operator=(const NativeCode&) = delete;
+        NativeCode(NativeCode&& other);
+        NativeCode& operator=(NativeCode&& other);
+
+        // false if the JIT isn't available or if the memory couldn't be allocated
+        bool load(const std::vector<uint8_t>& code);
+        void unload();
+
+        inline NativeFunction function() const
+        {
+            return m_function;
+        }
+
+        inline std::size_t size() const
+        {
+            return m_size;
+        }
+
+    private:
+        void* m_memory;
+        std::size_t m_size;
+        NativeFunction m_function;
+    };
+
+    /*
+        Generates x86-64 code for a page (System V calling convention), the native code keeping the VM
+        in rbx. The hot instructions are inlined from templates working on numbers, which jump to a
+        slow path when their guards fail. The other instructions, and the slow paths, call the helper
+        of the instruction, run by the handler of the interpreter. A helper returns the index of the
+        next instruction in eax: the code continues with the following instruction or with a jump
+        target when it's the expected one, otherwise it jumps to the code of that instruction through
+        a table of offsets, or goes back to the VM on -1
+    */
+    class NativeAssembler
+    {
+    public:
+        // number of instructions of the page
+        NativeAssembler(std::size_t instructions, const NativeLayout& layout);
+
+        // the following code is the one of the instruction ip, bound in order
+        void bind(std::size_t ip);
+        // after the last instruction: binds the instructions left, and goes back to the VM
+        void endPage();
+
+        // a label for the code of the slow paths, following the instructions
+        std::size_t newLabel();
+        void bindLabel(std::size_t label);
+
+        // templates of the inlined instructions, slow being the label of the code to run if a guard fails.
+        // Push the number in a slot of the current scope
+        void loadLocal(uint16_t slot, std::size_t slow);
+        // pop into a slot of the current scope holding a number
+        void storeLocal(uint16_t slot, const NativeValue& undefined, std::size_t slow);
+        // push a value which isn't boxed
+        void loadConst(const NativeValue& value, std::size_t slow);
+        // replace the two numbers on top of the stack by the result of the operator
+        void numberOperator(NativeOperator op, const NativeValue& true_value, const NativeValue& false_value, std::size_t slow);
+        // pop and jump to the instruction target if the value was this NFT
+        void popJumpIf(const NativeValue& value, std::size_t target, std::size_t slow);
+
+        // call helper(vm, ip, page), eax holding its result
+        void callHelper(NativeHelper helper, int ip, int page);
+        // continue at the instruction target if eax == value
+        void jumpIfEqual(int value, std::size_t target);
+        // continue at the instruction given by eax if it isn't value
+        void dispatchUnless(int value);
+        // continue at the instruction given by eax
+        void dispatch();
+        // to an instruction or to a label of newLabel
+        void jump(std::size_t target);
+
+        // the code followed by the table of the instructions offsets
+        std::vector<uint8_t> finalize();
+
+    private:
+        // a rel32 operand and the label it refers to
+        struct Fixup
+        {
+            std::size_t position;
+            std::size_t label;
+        };
+
+        NativeLayout m_layout;
+        std::vector<uint8_t> m_code;
+        std::size_t m_instructions;
+        // offset of each instruction, then of the end of the page, then the labels of newLabel
+        std::vector<std::size_t> m_labels;
+        std::vector<Fixup> m_fixups;
+        std::size_t m_dispatch;  // offset of the code jumping to the instruction given by eax
+        std::size_t m_exit;      // offset of the code going back to the VM
+        std::size_t m_table_disp;  // offset of the displacement of the table in the dispatch code
+        std::size_t m_bound;
+
+        void emit(std::initializer_list<uint8_t> bytes);
+        void emit32(uint32_t value);
+        void emit64(uint64_t value);
+        void patch32(std::size_t position, uint32_t value);
+        // operand [base + disp32], reg being a register or the extension of the opcode
+        void memory(uint8_t reg, uint8_t base, int32_t disp);
+        // jcc rel32 to a label, cc being the low nibble of the opcode (0x84 je, 0x85 jne...)
+        void jumpIf(uint8_t condition, std::size_t label);
+        // rcx = address of the value of index sp, rax holding sp
+        void stackAddress();
+        // jump to slow if the value at rcx + offset is boxed, it can't be overwritten without releasing it
+        void guardNotBoxed(int8_t offset, std::size_t slow);
+        // write a value at rcx + offset
+        void storeValue(const NativeValue& value, int8_t offset);
+        // rel32 operand jumping to a label, to the dispatch code or to the exit
+        void emitRel32(std::size_t label);
+        std::size_t labelOffset(std::size_t label);
+
+        static constexpr std::size_t DispatchLabel = static_cast<std::size_t>(-1);
+        static constexpr std::size_t ExitLabel = static_cast<std::size_t>(-2);
+    };
+}
+
+#endif
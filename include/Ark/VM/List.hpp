@@ -0,0 +1,29 @@
+#ifndef ark_vm_list
+#define ark_vm_list
+
+#include <vector>
+
+#include <Ark/Constants.hpp>
+#ifdef ARK_PERSISTENT_LISTS
+    #include <Ark/VM/PersistentVector.hpp>
+#endif
+
+namespace Ark::internal
+{
+    class Value;
+
+    // storage of the lists, chosen when building ArkScript with the cmake option ARK_PERSISTENT_LISTS
+#ifdef ARK_PERSISTENT_LISTS
+    using List = PersistentVector<Value>;
+#else
+    using List = std::vector<Value>;
+#endif
+
+    // the list without its first element, sharing the elements with it if the backend can
+    List dropFirst(const List& list);
+
+    // add the elements of other at the end of list
+    void appendAll(List& list, const List& other);
+}
+
+#endif
@@ -0,0 +1,436 @@
+#ifndef ark_vm_persistentvector
+#define ark_vm_persistentvector
+
+#include <cinttypes>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+
+namespace Ark::internal
+{
+    /*
+        Persistent vector, the list backend used when ArkScript is built with ARK_PERSISTENT_LISTS:
+        a 32-way trie holding the elements by blocks of 32, the last block (the tail) being kept out
+        of the trie so that push_back doesn't walk it most of the time. The nodes are refcounted and
+        shared by the copies of a vector, a copy costs O(1), and a vector modifies the nodes it owns
+        alone in place, copying only the path to the element modified when they are shared.
+        The first elements can be dropped in O(1), the vector keeping the index of its first element;
+        the trie is rebuilt once more elements were dropped than there are left.
+        Like the boxes of the values, the refcounts aren't atomic: a vector must not be shared by two threads
+    */
+    template <typename T>
+    class PersistentVector
+    {
+    public:
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            const_iterator(const PersistentVector* vector, std::size_t index) :
+                m_vector(vector), m_index(index), m_block(index < vector->m_count ? vector->blockFor(index) : nullptr)
+            {}
+
+            inline reference operator*() const
+            {
+                return m_block[m_index & Mask];
+            }
+
+            inline pointer operator->() const
+            {
+                return &m_block[m_index & Mask];
+            }
+
+            inline const_iterator& operator++()
+            {
+                // walk the trie only when changing of block
+                if ((++m_index & Mask) == 0 && m_index < m_vector->m_count)
+                    m_block = m_vector->blockFor(m_index);
+                return *this;
+            }
+
+            inline const_iterator operator++(int)
+            {
+                const_iterator copy(*this);
+                ++*this;
+                return copy;
+            }
+
+            friend inline bool operator==(const const_iterator& A, const const_iterator& B)
+            {
+                return A.m_index == B.m_index;
+            }
+
+            friend inline bool operator!=(const const_iterator& A, const const_iterator& B)
+            {
+                return A.m_index != B.m_index;
+            }
+
+        private:
+            const PersistentVector* m_vector;
+            std::size_t m_index;
+            const T* m_block;
+        };
+
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = const_iterator;
+
+        PersistentVector() :
+            m_root(nullptr), m_tail(nullptr), m_count(0), m_start(0), m_shift(Bits)
+        {}
+
+        template <typename InputIt>
+        PersistentVector(InputIt first, InputIt last) :
+            PersistentVector()
+        {
+            for (; first != last; ++first)
+                push_back(*first);
+        }
+
+        PersistentVector(const PersistentVector& other) :
+            m_root(other.m_root), m_tail(other.m_tail), m_count(other.m_count), m_start(other.m_start), m_shift(other.m_shift)
+        {
+            retain(m_root);
+            retain(m_tail);
+        }
+
+        PersistentVector(PersistentVector&& other) noexcept :
+            m_root(other.m_root), m_tail(other.m_tail), m_count(other.m_count), m_start(other.m_start), m_shift(other.m_shift)
+        {
+            other.m_root = nullptr;
+            other.m_tail = nullptr;
+            other.m_count = other.m_start = 0;
+            other.m_shift = Bits;
+        }
+
+        PersistentVector& operator=(const PersistentVector& other)
+        {
+            PersistentVector copy(other);
+            swap(copy);
+            return *this;
+        }
+
+        PersistentVector& operator=(PersistentVector&& other) noexcept
+        {
+            PersistentVector copy(std::move(other));
+            swap(copy);
+            return *this;
+        }
+
+        ~PersistentVector()
+        {
+            releaseBranch(m_root);
+            releaseLeaf(m_tail);
+        }
+
+        inline std::size_t size() const
+        {
+            return m_count - m_start;
+        }
+
+        inline bool empty() const
+        {
+            return m_count == m_start;
+        }
+
+        inline const T& operator[](std::size_t index) const
+        {
+            std::size_t i = m_start + index;
+            return blockFor(i)[i & Mask];
+        }
+
+        inline const T& front() const
+        {
+            return (*this)[0];
+        }
+
+        inline const T& back() const
+        {
+            return (*this)[size() - 1];
+        }
+
+        inline const_iterator begin() const
+        {
+            return const_iterator(this, m_start);
+        }
+
+        inline const_iterator end() const
+        {
+            return const_iterator(this, m_count);
+        }
+
+        void push_back(T value)
+        {
+            std::size_t tail_offset = tailOffset();
+
+            if (m_count - tail_offset < Width && m_tail != nullptr)
+            {
+                // room left in the tail
+                m_tail = editable(m_tail);
+                m_tail->values[m_count - tail_offset] = std::move(value);
+            }
+            else
+            {
+                // the tail is full, it goes into the trie, which gets a new level if it is full too
+                if (m_tail != nullptr)
+                {
+                    if ((m_count >> Bits) > (std::size_t(1) << m_shift))
+                    {
+                        Branch* root = new Branch();
+                        root->children[0] = m_root;
+                        root->children[1] = newPath(m_shift, m_tail);
+                        m_root = root;
+                        m_shift += Bits;
+                    }
+                    else
+                        m_root = pushTail(m_shift, m_root, m_tail);
+                }
+                m_tail = new Leaf();
+                m_tail->values[0] = std::move(value);
+            }
+            ++m_count;
+        }
+
+        void pop_back()
+        {
+            if (size() <= 1)
+            {
+                clear();
+                return;
+            }
+
+            if (m_count - tailOffset() > 1)
+            {
+                // the last element is in the tail, it is released only if the tail isn't shared
+                if (m_tail->refcount == 1)
+                    m_tail->values[(m_count - 1) & Mask] = T();
+            }
+            else
+            {
+                // the tail is empty, the last block of the trie becomes the tail
+                Leaf* tail = const_cast<Leaf*>(leafFor(m_count - 2));
+                retain(tail);
+                m_root = popTail(m_shift, m_root);
+                if (m_shift > Bits && m_root != nullptr && m_root->children[1] == nullptr)
+                {
+                    Branch* root = static_cast<Branch*>(m_root->children[0]);
+                    retain(root);
+                    releaseBranch(m_root);
+                    m_root = root;
+                    m_shift -= Bits;
+                }
+                releaseLeaf(m_tail);
+                m_tail = tail;
+            }
+            --m_count;
+        }
+
+        void pop_front()
+        {
+            if (size() <= 1)
+            {
+                clear();
+                return;
+            }
+
+            ++m_start;
+            // the elements dropped are still referenced by the trie, free them once they are the majority
+            if (m_start >= Width && m_start > size())
+            {
+                PersistentVector copy(begin(), end());
+                swap(copy);
+            }
+        }
+
+        void clear()
+        {
+            PersistentVector().swap(*this);
+        }
+
+        void swap(PersistentVector& other) noexcept
+        {
+            std::swap(m_root, other.m_root);
+            std::swap(m_tail, other.m_tail);
+            std::swap(m_count, other.m_count);
+            std::swap(m_start, other.m_start);
+            std::swap(m_shift, other.m_shift);
+        }
+
+        friend bool operator==(const PersistentVector& A, const PersistentVector& B)
+        {
+            if (A.size() != B.size())
+                return false;
+            for (const_iterator a = A.begin(), b = B.begin(), end = A.end(); a != end; ++a, ++b)
+            {
+                if (!(*a == *b))
+                    return false;
+            }
+            return true;
+        }
+
+        friend inline bool operator!=(const PersistentVector& A, const PersistentVector& B)
+        {
+            return !(A == B);
+        }
+
+    private:
+        static constexpr unsigned Bits = 5;
+        static constexpr std::size_t Width = std::size_t(1) << Bits;
+        static constexpr std::size_t Mask = Width - 1;
+
+        struct Node
+        {
+            uint32_t refcount = 1;
+        };
+
+        // the depth of a node tells if it is a branch or a leaf, the leaves being at the bottom of the trie
+        struct Branch : public Node
+        {
+            Node* children[Width] = {};  // null after the last child
+        };
+
+        struct Leaf : public Node
+        {
+            T values[Width];
+        };
+
+        Branch* m_root;  // null while the elements fit in the tail
+        Leaf* m_tail;  // null when the vector is empty
+        std::size_t m_count;  // elements in the trie and in the tail, including the dropped ones
+        std::size_t m_start;  // index of the first element, the ones before were dropped
+        unsigned m_shift;  // bits to shift an index by to get the child of the root holding it
+
+        // index of the first element in the tail
+        inline std::size_t tailOffset() const
+        {
+            return m_count < Width ? 0 : ((m_count - 1) >> Bits) << Bits;
+        }
+
+        const Leaf* leafFor(std::size_t index) const
+        {
+            if (index >= tailOffset())
+                return m_tail;
+
+            const Node* node = m_root;
+            for (unsigned level = m_shift; level > 0; level -= Bits)
+                node = static_cast<const Branch*>(node)->children[(index >> level) & Mask];
+            return static_cast<const Leaf*>(node);
+        }
+
+        inline const T* blockFor(std::size_t index) const
+        {
+            return leafFor(index)->values;
+        }
+
+        // put a full tail under a branch at the given level, creating the branches missing
+        Branch* pushTail(unsigned level, Branch* parent, Leaf* tail)
+        {
+            Branch* branch = parent == nullptr ? new Branch() : editable(parent);
+            std::size_t index = ((m_count - 1) >> level) & Mask;
+
+            if (level == Bits)
+                branch->children[index] = tail;
+            else if (Node* child = branch->children[index])
+                branch->children[index] = pushTail(level - Bits, static_cast<Branch*>(child), tail);
+            else
+                branch->children[index] = newPath(level - Bits, tail);
+            return branch;
+        }
+
+        // remove the last leaf under a branch at the given level, the branches left empty are freed
+        Branch* popTail(unsigned level, Branch* branch)
+        {
+            std::size_t index = ((m_count - 2) >> level) & Mask;
+
+            if (level > Bits)
+            {
+                Branch* copy = editable(branch);
+                copy->children[index] = popTail(level - Bits, static_cast<Branch*>(copy->children[index]));
+                if (copy->children[index] == nullptr && index == 0)
+                {
+                    releaseBranch(copy, level);
+                    return nullptr;
+                }
+                return copy;
+            }
+            else if (index == 0)
+            {
+                releaseBranch(branch, level);
+                return nullptr;
+            }
+
+            Branch* copy = editable(branch);
+            releaseLeaf(static_cast<Leaf*>(copy->children[index]));
+            copy->children[index] = nullptr;
+            return copy;
+        }
+
+        static Node* newPath(unsigned level, Leaf* leaf)
+        {
+            if (level == 0)
+                return leaf;
+            Branch* branch = new Branch();
+            branch->children[0] = newPath(level - Bits, leaf);
+            return branch;
+        }
+
+        // take a reference on a node, and give a node owned only by the caller: the same one if the
+        // reference was the only one, otherwise a copy
+        template <typename N>
+        static N* editable(N* node)
+        {
+            if (node->refcount == 1)
+                return node;
+
+            --node->refcount;
+            N* copy = new N(*node);
+            copy->refcount = 1;
+            if constexpr (std::is_same_v<N, Branch>)
+            {
+                for (Node* child : copy->children)
+                    retain(child);
+            }
+            return copy;
+        }
+
+        static inline void retain(Node* node)
+        {
+            if (node != nullptr)
+                ++node->refcount;
+        }
+
+        inline void releaseBranch(Branch* branch)
+        {
+            releaseBranch(branch, m_shift);
+        }
+
+        static void releaseBranch(Branch* branch, unsigned level)
+        {
+            if (branch == nullptr || --branch->refcount > 0)
+                return;
+
+            for (Node* child : branch->children)
+            {
+                if (level == Bits)
+                    releaseLeaf(static_cast<Leaf*>(child));
+                else
+                    releaseBranch(static_cast<Branch*>(child), level - Bits);
+            }
+            delete branch;
+        }
+
+        static void releaseLeaf(Leaf* leaf)
+        {
+            if (leaf != nullptr && --leaf->refcount == 0)
+                delete leaf;
+        }
+    };
+}
+
+#endif
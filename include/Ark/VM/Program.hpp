@@ -0,0 +1,101 @@
+#ifndef ark_vm_program
+#define ark_vm_program
+
+#include <vector>
+#include <string>
+#include <cinttypes>
+
+#include <Ark/Compiler/BytecodeReader.hpp>
+#include <Ark/VM/Value.hpp>
+#include <Ark/VM/Types.hpp>
+
+namespace Ark
+{
+    // optimizations done by the VM, they can be disabled to compare them
+    enum VMFeatures : uint16_t
+    {
+        FeatureSuperinstructions = 1 << 0,  // fuse the most frequent sequences of instructions
+        FeatureComputedGoto = 1 << 1,       // direct threaded dispatch loop, needs a build with ARK_COMPUTED_GOTO
+        FeatureQuickening = 1 << 2,         // specialize the operators for numbers when running them
+        FeatureJIT = 1 << 3,                // compile the most called functions to native code, x86-64 Linux only
+
+        DefaultFeatures = FeatureSuperinstructions | FeatureComputedGoto | FeatureQuickening
+    };
+
+    /*
+        Bytecode loaded and validated once: the tables and the decoded pages. A program isn't
+        modified after its creation, thus many VMs, running in different threads, can share it
+        through a std::shared_ptr<const Program> instead of decoding the same bytecode again
+    */
+    class Program
+    {
+    public:
+        // filename: file the bytecode comes from, the plugins are looked for next to it
+        // features: only FeatureSuperinstructions is used when decoding the pages
+        Program(const bytecode_t& bytecode, const std::string& filename="FILE", uint16_t features=DefaultFeatures, bool debug=false);
+
+        inline const std::vector<std::string>& symbols() const
+        {
+            return m_symbols;
+        }
+
+        inline const std::vector<internal::Value>& constants() const
+        {
+            return m_constants;
+        }
+
+        inline const std::vector<std::string>& plugins() const
+        {
+            return m_plugins;
+        }
+
+        inline const std::vector<std::vector<internal::DecodedInst>>& pages() const
+        {
+            return m_pages;
+        }
+
+        // address in the bytecode of each decoded instruction, relative to the start of its page,
+        // to report the positions as the bytecode reader shows them
+        inline const std::vector<std::vector<uint16_t>>& addresses() const
+        {
+            return m_addresses;
+        }
+
+        // symbols declared by each page
+        inline const std::vector<std::vector<uint16_t>>& scopeLayouts() const
+        {
+            return m_scope_layouts;
+        }
+
+        inline const std::string& filename() const
+        {
+            return m_filename;
+        }
+
+        // number of superinstructions created when decoding the pages
+        inline std::size_t superinstructionsCount() const
+        {
+            return m_superinstructions_count;
+        }
+
+    private:
+        std::string m_filename;
+        bool m_debug;
+        std::vector<std::string> m_symbols;
+        std::vector<internal::Value> m_constants;
+        std::vector<std::string> m_plugins;
+        std::vector<std::vector<internal::DecodedInst>> m_pages;
+        std::vector<std::vector<uint16_t>> m_addresses;
+        std::vector<std::vector<uint16_t>> m_scope_layouts;
+        std::size_t m_superinstructions_count;
+
+        void load(const bytecode_t& bytecode, uint16_t features);
+        void fuseInstructions(std::vector<internal::DecodedInst>& page);
+
+        static bool isDecodable(uint8_t inst);
+        static bool hasArgument(uint8_t inst);
+        void throwVMError(const std::string& message);
+    };
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef ark_vm_ref
+#define ark_vm_ref
+
+#include <new>
+#include <utility>
+#include <cinttypes>
+
+namespace Ark::internal
+{
+    /*
+        Refcounted handle on an object owned by a VM (the scopes), a single pointer on a block
+        holding the counters and the object. The counters aren't atomic since a VM runs on a single
+        thread: an object must not be shared by two threads, the values given to another thread are
+        deep copied (see internal::Transfer). The object is destroyed with its last Ref, the block
+        being freed once the WeakRefs on it are gone too
+    */
+    template <typename T>
+    class Ref
+    {
+    public:
+        struct Block
+        {
+            uint32_t refcount;
+            uint32_t weakcount;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            inline T* object()
+            {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        Ref() :
+            m_block(nullptr)
+        {}
+
+        Ref(const Ref& other) :
+            m_block(other.m_block)
+        {
+            if (m_block != nullptr)
+                ++m_block->refcount;
+        }
+
+        Ref(Ref&& other) noexcept :
+            m_block(other.m_block)
+        {
+            other.m_block = nullptr;
+        }
+
+        Ref& operator=(const Ref& other)
+        {
+            Ref copy(other);
+            std::swap(m_block, copy.m_block);
+            return *this;
+        }
+
+        Ref& operator=(Ref&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release(m_block);
+                m_block = other.m_block;
+                other.m_block = nullptr;
+            }
+            return *this;
+        }
+
+        ~Ref()
+        {
+            release(m_block);
+        }
+
+        template <typename... Args>
+        static Ref make(Args&&... args)
+        {
+            Block* block = new Block;
+            try
+            {
+                new (block->storage) T(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                delete block;
+                throw;
+            }
+            block->refcount = 1;
+            block->weakcount = 0;
+            return Ref(block);
+        }
+
+        inline T* get() const
+        {
+            return m_block != nullptr ? m_block->object() : nullptr;
+        }
+
+        inline T& operator*() const
+        {
+            return *m_block->object();
+        }
+
+        inline T* operator->() const
+        {
+            return m_block->object();
+        }
+
+        inline explicit operator bool() const
+        {
+            return m_block != nullptr;
+        }
+
+        inline std::size_t use_count() const
+        {
+            return m_block != nullptr ? m_block->refcount : 0;
+        }
+
+        inline void reset()
+        {
+            release(m_block);
+            m_block = nullptr;
+        }
+
+        friend inline bool operator==(const Ref& A, const Ref& B)
+        {
+            return A.m_block == B.m_block;
+        }
+
+        friend inline bool operator!=(const Ref& A, const Ref& B)
+        {
+            return A.m_block != B.m_block;
+        }
+
+    private:
+        template <typename U>
+        friend class WeakRef;
+
+        Block* m_block;
+
+        explicit Ref(Block* block) :
+            m_block(block)
+        {}
+
+        static void release(Block* block)
+        {
+            if (block != nullptr && --block->refcount == 0)
+            {
+                block->object()->~T();
+                if (block->weakcount == 0)
+                    delete block;
+            }
+        }
+    };
+
+    template <typename T, typename... Args>
+    inline Ref<T> makeRef(Args&&... args)
+    {
+        return Ref<T>::make(std::forward<Args>(args)...);
+    }
+
+    // does not keep the object alive, lock() gives a Ref on it if it still exists
+    template <typename T>
+    class WeakRef
+    {
+    public:
+        WeakRef(const Ref<T>& ref) :
+            m_block(ref.m_block)
+        {
+            if (m_block != nullptr)
+                ++m_block->weakcount;
+        }
+
+        WeakRef(const WeakRef& other) :
+            m_block(other.m_block)
+        {
+            if (m_block != nullptr)
+                ++m_block->weakcount;
+        }
+
+        WeakRef(WeakRef&& other) noexcept :
+            m_block(other.m_block)
+        {
+            other.m_block = nullptr;
+        }
+
+        WeakRef& operator=(const WeakRef& other)
+        {
+            WeakRef copy(other);
+            std::swap(m_block, copy.m_block);
+            return *this;
+        }
+
+        WeakRef& operator=(WeakRef&& other) noexcept
+        {
+            std::swap(m_block, other.m_block);
+            return *this;
+        }
+
+        ~WeakRef()
+        {
+            if (m_block != nullptr && --m_block->weakcount == 0 && m_block->refcount == 0)
+                delete m_block;
+        }
+
+        inline bool expired() const
+        {
+            return m_block == nullptr || m_block->refcount == 0;
+        }
+
+        inline Ref<T> lock() const
+        {
+            if (expired())
+                return Ref<T>();
+            ++m_block->refcount;
+            return Ref<T>(m_block);
+        }
+
+    private:
+        typename Ref<T>::Block* m_block;
+    };
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef ark_vm_scope
+#define ark_vm_scope
+
+#include <vector>
+#include <utility>
+#include <cinttypes>
+
+#include <Ark/VM/Value.hpp>
+
+namespace Ark::internal
+{
+    /*
+        A scope holds only the variables created in it, as (symbol id, value) pairs.
+        The symbols declared by the page the scope was created for get a slot
+        when the scope is created (the layout of the page, computed by the compiler),
+        the ones added at runtime are appended
+    */
+    class Scope
+    {
+    public:
+        Scope();
+        Scope(const std::vector<uint16_t>& layout);
+        // a slot for each symbol, the slot of a symbol being its id
+        Scope(std::size_t symbols_count);
+
+        // return nullptr if the variable isn't in this scope
+        inline Value* operator[](uint16_t id)
+        {
+            // fast path for the scopes which have a slot for every symbol
+            if (id < m_data.size() && m_data[id].first == id)
+                return &m_data[id].second;
+
+            for (auto& pair : m_data)
+            {
+                if (pair.first == id)
+                    return &pair.second;
+            }
+            return nullptr;
+        }
+
+        inline const Value* operator[](uint16_t id) const
+        {
+            return (*const_cast<Scope*>(this))[id];
+        }
+
+        // create the variable if it doesn't exist, otherwise replace its value
+        template <typename T>
+        inline Value& set(uint16_t id, T&& value)
+        {
+            Value* var = (*this)[id];
+            if (var != nullptr)
+                return *var = std::forward<T>(value);
+            m_data.emplace_back(id, std::forward<T>(value));
+            return m_data.back().second;
+        }
+
+        // add a variable without looking for it, the scope must not have it already
+        inline void push_back(uint16_t id, Value&& value)
+        {
+            m_data.emplace_back(id, std::move(value));
+        }
+
+        // reuse the storage of the scope for a new layout, used to pool the scopes
+        inline void reset(const std::vector<uint16_t>& layout)
+        {
+            m_data.clear();
+            m_data.reserve(layout.size() + 1);
+            for (uint16_t id : layout)
+                m_data.emplace_back(id, Value());
+        }
+
+        inline void clear()
+        {
+            m_data.clear();
+        }
+
+        // slot related, to access the variables declared by the layout
+
+        inline Value& slot(std::size_t i)
+        {
+            return m_data[i].second;
+        }
+
+        inline const Value& slot(std::size_t i) const
+        {
+            return m_data[i].second;
+        }
+
+        inline uint16_t idOfSlot(std::size_t i) const
+        {
+            return m_data[i].first;
+        }
+
+        inline std::size_t size() const
+        {
+            return m_data.size();
+        }
+
+        // the slots, read and written by the native code
+        inline std::pair<uint16_t, Value>* slots()
+        {
+            return m_data.data();
+        }
+
+    private:
+        std::vector<std::pair<uint16_t, Value>> m_data;
+    };
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef ark_vm_transfer
+#define ark_vm_transfer
+
+#include <unordered_map>
+
+#include <Ark/VM/Value.hpp>
+#include <Ark/VM/Scope.hpp>
+
+namespace Ark::internal
+{
+    /*
+        The refcounts of the boxes and of the scopes aren't atomic: a value can not be shared by two
+        threads. The values given to another thread (the constants of a program, the arguments and
+        the results of the VMPool jobs, the values used by the pmap workers) are deep copied, the copy
+        sharing nothing with the original, which is only read. The scopes, the generators and the
+        string builders are copied once for all the values given to the same Transfer, so that a
+        closure stored in the scope it captured is still stored in the copy of that scope
+    */
+    class Transfer
+    {
+    public:
+        Value value(const Value& value);
+        Scope_t scope(const Scope& scope);
+
+        // the scopes copied so far, by address of the original
+        inline const std::unordered_map<const Scope*, Scope_t>& scopes() const
+        {
+            return m_scopes;
+        }
+
+    private:
+        std::unordered_map<const Scope*, Scope_t> m_scopes;
+        std::unordered_map<const Generator*, Value> m_generators;
+        std::unordered_map<const std::string*, Value> m_builders;
+    };
+}
+
+#endif
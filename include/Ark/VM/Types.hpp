@@ -7,6 +7,13 @@ namespace Ark::internal
 {
     enum class NFT { Nil, False, True, Undefined };
     using PageAddr_t = uint16_t;
+
+    // instruction as executed by the VM, with its operand already decoded
+    struct DecodedInst
+    {
+        uint8_t inst;
+        uint16_t arg;
+    };
 }
 
 #endif
\ No newline at end of file
@@ -9,12 +9,24 @@
 #include <memory>
 #include <unordered_map>
 #include <utility>
+#include <array>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstddef>
 
 #include <Ark/VM/Value.hpp>
+#include <Ark/VM/Scope.hpp>
 #include <Ark/VM/Frame.hpp>
+#include <Ark/VM/CycleCollector.hpp>
+#include <Ark/VM/Transfer.hpp>
 #include <Ark/Compiler/Compiler.hpp>
 #include <Ark/VM/Plugin.hpp>
 #include <Ark/VM/FFI.hpp>
+#include <Ark/VM/JIT.hpp>
+#include <Ark/VM/Program.hpp>
 #include <Ark/Log.hpp>
 
 #undef abs
@@ -24,95 +36,312 @@ namespace Ark
 {
     using namespace std::string_literals;
 
+    // allocations done by the VM when running code, to check the pooling of scopes and frames
+    struct AllocationCounters
+    {
+        std::size_t calls = 0;             // functions and closures called
+        std::size_t scopes_allocated = 0;  // scopes created on the heap
+        std::size_t scopes_reused = 0;     // scopes taken from the pool
+        std::size_t stack_grows = 0;       // the stack of values had to grow
+        std::size_t frames_grows = 0;      // the stack of frames or of scopes had to grow
+        std::size_t cycle_collections = 0; // runs of the cycle collector
+        std::size_t scopes_reclaimed = 0;  // scopes freed by the cycle collector
+    };
+
+    // why a resumable run stopped, see VM::start
+    enum class RunState
+    {
+        Finished,     // the program halted, or the function called returned
+        OutOfBudget,  // the instructions budget was spent
+        Yielded       // the code called (yieldToHost)
+    };
+
     template<bool debug>
     class VM_t
     {
     public:
-        VM_t(bool persist=false);
+        VM_t(bool persist=false, uint16_t features=DefaultFeatures);
 
         void feed(const std::string& filename);
         void feed(const bytecode_t& bytecode);
+        // use a program already loaded, which can be shared with other VMs
+        void feed(std::shared_ptr<const Program> program);
         void doFile(const std::string& filename);
 
         void loadFunction(const std::string& name, internal::Value::ProcType function);
         void run();
 
+        /*
+            Resumable runs, to run many scripts on the same thread: start() runs the program like run(),
+            startCall() calls a function like call(), but the VM pauses after running budget instructions
+            (no limit if 0) or when the code calls (yieldToHost). The VM keeps its IP, PP, frames and stack, and
+            resume() continues from there. The errors are given to the caller, the VM being reset.
+            The instructions run as native code by the JIT can't be counted, it isn't used with a budget
+        */
+        RunState start(std::size_t budget=0);
+        RunState startCall(const std::string& name, const std::vector<internal::Value>& args, std::size_t budget=0);
+        RunState resume(std::size_t budget=0);
+        // value returned by the function given to startCall, once finished. Can be taken only once
+        internal::Value result();
+
+        inline RunState runState() const
+        {
+            return m_run_state;
+        }
+
         internal::Value& operator[](const std::string& name);
 
+        inline const AllocationCounters& allocationCounters() const
+        {
+            return m_counters;
+        }
+
+        inline const std::shared_ptr<const Program>& program() const
+        {
+            return m_program;
+        }
+
+        // number of superinstructions created when loading the bytecode
+        inline std::size_t superinstructionsCount() const
+        {
+            return m_program ? m_program->superinstructionsCount() : 0;
+        }
+
+        // number of instructions dispatched, always 0 if ARK_PROFILER wasn't enabled
+        inline std::size_t dispatchCount() const
+        {
+            return m_dispatch_count;
+        }
+
+        // number of code pages compiled to native code by the JIT
+        inline std::size_t nativePagesCount() const
+        {
+            return std::count_if(m_native.begin(), m_native.end(), [](const internal::NativeCode& code) {
+                return code.function() != nullptr;
+            });
+        }
+
         template <typename... Args>
         internal::Value&& call(const std::string& name, Args&&... args)
         {
-            using namespace Ark::internal;
+            // convert the arguments
+            std::vector<internal::Value> fnargs { args... };
+            return callWithArguments(name, fnargs);
+        }
 
-            // find id of function
-            auto it = std::find(m_symbols.begin(), m_symbols.end(), name);
-            if (it == m_symbols.end())
-            {
-                if constexpr (debug)
-                    throwVMError("Couldn't find symbol with name " + name);
-            }
+        // same as call, the arguments being given in a vector. The errors raised by the function are
+        // given to the caller, the VM being put back in the state it had before the call
+        internal::Value&& callWithArguments(const std::string& name, const std::vector<internal::Value>& args)
+        {
+            uint16_t id = 0;
+            const internal::Value& function = findFunction(name, id);
+            return callFunction(function, id, args);
+        }
 
-            // find function object and push it if it's a pageaddr/closure
-            uint16_t id = static_cast<uint16_t>(std::distance(m_symbols.begin(), it));
-            auto var = findNearestVariable(id);
-            if (var != nullptr)
-            {
-                if (var->valueType() != ValueType::PageAddr && var->valueType() != ValueType::Closure)
-                    throwVMError("Symbol " + name + " isn't a function");
-                
-                push(*var);
-                m_last_sym_loaded = id;
-            }
-            else
-                throwVMError("Couldn't load symbol with name " + name);
+        /*
+            Free the scopes which are only referenced by cycles, as a closure stored in the scope it
+            captured, returns the number of scopes freed. Run automatically each time the number of
+            scopes captured by closures and generators since the last run reaches a threshold
+        */
+        inline std::size_t collectCycles()
+        {
+            std::size_t freed = m_cycle_collector.collect();
+            ++m_counters.cycle_collections;
+            m_counters.scopes_reclaimed += freed;
+            return freed;
+        }
 
-            // convert and push arguments in reverse order
-            std::vector<Value> fnargs { args... };
-            for (auto it2=fnargs.rbegin(); it2 != fnargs.rend(); ++it2)
-                push(*it2);
+        // keep the values of the global variables, for reset() to put them back
+        void saveGlobals();
 
-            std::size_t frames_count = m_frames.size();
-            // call it
-            call(static_cast<int16_t>(sizeof...(Args)));
+        /*
+            Cheap alternative to run() to reuse the VM between calls: the stack, the frames and the
+            scopes are cleared, the global scope is kept, with the values saved by saveGlobals() if
+            any, the closures, the generators and the string builders being copied again since they
+            are modified in place. The plugins aren't loaded again and the global code isn't run again
+        */
+        void reset();
 
-            // run until the function returns
-            safeRun(/* untilFrameCount */ frames_count);
+        /*
+            Run the pages with the given functions instead of interpreting them, by page id (code
+            generated by ark-aot from the same bytecode). Enables FeatureJIT, the pages without a
+            function being compiled by the JIT once they're hot
+        */
+        void loadNativeCode(const std::vector<internal::NativeFunction>& functions);
 
-            // get result
-            return pop();
-        }
+        // run an instruction for the native code (see internal::NativeHelper)
+        template<uint8_t inst>
+        static int nativeHelper(void* vm, int ip, int page);
 
     private:
         bool m_persist;
-        bytecode_t m_bytecode;
+        uint16_t m_features;
         // Instruction Pointer and Page Pointer
         int m_ip;
         std::size_t m_pp;
         bool m_running;
-        std::string m_filename;
         uint16_t m_last_sym_loaded;
         std::size_t m_until_frame_count;
 
         // related to the bytecode
-        std::vector<std::string> m_symbols;
-        std::vector<internal::Value> m_constants;
-        std::vector<std::string> m_plugins;
+        std::shared_ptr<const Program> m_program;
         std::vector<internal::SharedLibrary> m_shared_lib_objects;
-        std::vector<bytecode_t> m_pages;
+        // the pages of the program, shared with the other VMs fed with it, except the ones the VM
+        // quickened: a page is copied into m_own_pages the first time one of its instructions is rewritten
+        std::vector<const internal::DecodedInst*> m_pages;
+        std::vector<std::vector<internal::DecodedInst>> m_own_pages;
+        const internal::Value* m_constants;  // the constants of the program, read only
+        std::vector<internal::Value> m_string_constants;  // copies of the constant strings, their refcounts belong to the VM
 
         // related to the execution
+        std::vector<internal::Value> m_stack;  // shared by all the frames
+        std::size_t m_sp;  // number of values in the stack
+        std::size_t m_fp;  // stack base of the current frame
         std::vector<internal::Frame> m_frames;
         std::optional<internal::Scope_t> m_saved_scope;
+        std::optional<internal::Scope> m_saved_globals;
+        std::vector<std::size_t> m_mutable_globals;  // slots of the saved globals copied by reset(), see modifiedInPlace
         std::vector<internal::Scope_t> m_locals;
+        std::vector<internal::Scope_t> m_scope_pool;  // scopes which aren't used anymore
+        std::vector<internal::Value> m_proc_args;  // reused to give their arguments to the builtins
+        std::vector<internal::Value> m_characters;  // the strings of a single character, created once
+        std::vector<internal::Value> m_generators;  // generators being run, the innermost one last
+        internal::CycleCollector m_cycle_collector;
+        AllocationCounters m_counters;
+        std::size_t m_dispatch_count;
+
+        // related to the JIT
+        std::vector<internal::NativeCode> m_native;  // native code of each page, empty until compiled
+        std::vector<unsigned> m_calls_count;  // calls of each page, the hot ones are compiled
+        std::exception_ptr m_native_error;  // raised by an instruction run from native code
+        // read by the instructions inlined in the native code, see refreshNativeState
+        internal::Value* m_native_stack;
+        std::size_t m_native_stack_size;
+        std::pair<uint16_t, internal::Value>* m_native_locals;
+
+        // related to the resumable runs
+        bool m_resumable;  // (yieldToHost) pauses the VM
+        std::size_t m_budget;  // instructions to run before pausing, for the next safeRun only
+        RunState m_run_state;
+
+        // reset the VM and load the plugins, before running the program
+        void init();
+        // rethrow: give the errors to the caller instead of displaying them
+        void safeRun(std::size_t untilFrameCount=0, bool rethrow=false);
+        RunState runResumable(std::size_t budget);
+
+        static constexpr std::size_t NoBudget = static_cast<std::size_t>(-1);
+
+        void runNative();
+        bool compileNative(std::size_t page);
+        internal::NativeLayout nativeLayout() const;
+
+        // the stack and the current scope may have been reallocated or changed by an instruction
+        // run by the VM, before the native code uses them again
+        inline void refreshNativeState()
+        {
+            m_native_stack = m_stack.data();
+            m_native_stack_size = m_stack.size();
+            m_native_locals = m_locals.empty() ? nullptr : m_locals.back()->slots();
+        }
+
+        // call the function on each element of the list from several threads, each running a VM
+        // created from the same program. Used by pmap and pforEach
+        std::vector<internal::Value> parallelCall(const internal::Value& function, const internal::List& list);
 
-        void configure();
-        void safeRun(std::size_t untilFrameCount=0);
+        // the function or closure with the given name, id being set to its symbol
+        internal::Value& findFunction(const std::string& name, uint16_t& id)
+        {
+            using namespace Ark::internal;
+
+            // find id of function
+            const auto& symbols = m_program->symbols();
+            auto it = std::find(symbols.begin(), symbols.end(), name);
+            if (it == symbols.end())
+            {
+                if constexpr (debug)
+                    throwVMError("Couldn't find symbol with name " + name);
+            }
+
+            // find function object, it should be a pageaddr/closure
+            id = static_cast<uint16_t>(std::distance(symbols.begin(), it));
+            auto var = findNearestVariable(id);
+            if (var == nullptr)
+                throwVMError("Couldn't load symbol with name " + name);
+            if (var->valueType() != ValueType::PageAddr && var->valueType() != ValueType::Closure)
+                throwVMError("Symbol " + name + " isn't a function");
+            return *var;
+        }
+
+        // push the arguments and call the function, the IP being left on its first instruction
+        void pushCall(const internal::Value& function, uint16_t id, const std::vector<internal::Value>& args)
+        {
+            // push arguments, then the function
+            for (auto&& arg : args)
+                push(arg);
+            push(function);
+            m_last_sym_loaded = id;
+
+            // call it, the IP is left before the first instruction of the function
+            call(static_cast<int16_t>(args.size()));
+            ++m_ip;
+        }
+
+        // call a function or a closure, id being the symbol it's given in its scope
+        internal::Value&& callFunction(const internal::Value& function, uint16_t id, const std::vector<internal::Value>& args)
+        {
+            using namespace Ark::internal;
+
+            std::size_t frames_count = m_frames.size();
+            std::size_t locals_count = m_locals.size();
+            std::size_t generators_count = m_generators.size();
+            std::size_t sp = m_sp;
+            int ip = m_ip;
+            std::size_t pp = m_pp;
+
+            try
+            {
+                pushCall(function, id, args);
+
+                // run until the function returns
+                safeRun(/* untilFrameCount */ frames_count, /* rethrow */ true);
+            }
+            catch (...)
+            {
+                // back to the state before the call, the VM can still be used
+                while (m_frames.size() > frames_count)
+                    m_frames.pop_back();
+                if (!m_frames.empty())
+                    m_frames.back().resetScopeCountToDelete();
+                while (m_locals.size() > locals_count)
+                    releaseScope();
+                stopGenerators(generators_count);
+                for (std::size_t i=sp; i < m_sp; ++i)
+                    m_stack[i] = Value();
+                m_sp = sp;
+                m_fp = m_frames.empty() ? 0 : m_frames.back().stackBase();
+                m_ip = ip;
+                m_pp = pp;
+                m_running = false;
+                throw;
+            }
+
+            // get result
+            return pop();
+        }
+
+        template<uint8_t inst>
+        inline void execute();
+        template<std::size_t... Insts>
+        static constexpr std::array<internal::NativeHelper, sizeof...(Insts)> makeNativeHelpers(std::index_sequence<Insts...>)
+        {
+            return { &VM_t<debug>::nativeHelper<static_cast<uint8_t>(Insts)>... };
+        }
 
         inline uint16_t readNumber()
         {
-            auto x = (static_cast<uint16_t>(m_pages[m_pp][m_ip]) << 8); ++m_ip;
-            auto y = (static_cast<uint16_t>(m_pages[m_pp][m_ip])     );
-            return x + y;
+            // the operands are decoded once, when loading the bytecode
+            return m_pages[m_pp][m_ip].arg;
         }
 
         // locals related
@@ -121,24 +350,25 @@ namespace Ark
         inline internal::Value& registerVariable(uint16_t id, internal::Value&& value)
         {
             if constexpr (pp == -1)
-                return (*m_locals.back())[id] = value;
-            return (*m_locals[pp])[id] = value;
+                return m_locals.back()->set(id, std::move(value));
+            return m_locals[pp]->set(id, std::move(value));
         }
 
         template <int pp=-1>
         inline internal::Value& registerVariable(uint16_t id, const internal::Value& value)
         {
             if constexpr (pp == -1)
-                return (*m_locals.back())[id] = value;
-            return (*m_locals[pp])[id] = value;
+                return m_locals.back()->set(id, value);
+            return m_locals[pp]->set(id, value);
         }
 
         inline internal::Value* findNearestVariable(uint16_t id)
         {
             for (auto it=m_locals.rbegin(); it != m_locals.rend(); ++it)
             {
-                if ((**it)[id] != internal::FFI::undefined)
-                    return &(**it)[id];
+                internal::Value* var = (**it)[id];
+                if (var != nullptr && *var != internal::FFI::undefined)
+                    return var;
             }
             return nullptr;
         }
@@ -147,18 +377,19 @@ namespace Ark
         {
             for (auto it=m_locals.rbegin(); it != m_locals.rend(); ++it)
             {
-                for (auto sub=(*it)->begin(); sub != (*it)->end(); ++sub)
+                for (std::size_t i=0, end=(*it)->size(); i < end; ++i)
                 {
-                    if (*sub == value)
-                        return static_cast<uint16_t>(std::distance((*it)->begin(), sub));
+                    if ((*it)->slot(i) == value)
+                        return (*it)->idOfSlot(i);
                 }
             }
             // oversized by one: didn't find anything
-            return static_cast<uint16_t>(m_symbols.size());
+            return static_cast<uint16_t>(m_program->symbols().size());
         }
 
+        // return nullptr if the variable isn't in the scope
         template<int pp=-1>
-        inline internal::Value& getVariableInScope(uint16_t id)
+        inline internal::Value* getVariableInScope(uint16_t id)
         {
             if constexpr (pp == -1)
                 return (*m_locals.back())[id];
@@ -169,12 +400,13 @@ namespace Ark
         {
             // remove frame
             m_frames.pop_back();
+            m_fp = m_frames.back().stackBase();
             uint8_t del_counter = m_frames.back().scopeCountToDelete();
-            m_locals.pop_back();
+            releaseScope();
             
             while (del_counter != 0)
             {
-                m_locals.pop_back();
+                releaseScope();
                 del_counter--;
             }
 
@@ -184,25 +416,118 @@ namespace Ark
                 m_running = false;
         }
 
-        inline void createNewScope()
+        // true if the value holds objects modified in place (the scopes of the closures, the generators, the
+        // string builders), the strings and the lists being copied on write
+        static bool modifiedInPlace(const internal::Value& value);
+
+        // remember a scope captured by a closure or a generator, it can be part of a cycle
+        inline void trackScope(const internal::Scope_t& scope)
         {
-            m_locals.emplace_back(
-                std::make_shared<std::vector<internal::Value>>(
-                    m_symbols.size(), internal::FFI::undefined
-                )
-            );
+            m_cycle_collector.track(scope);
+            if (m_cycle_collector.full())
+                collectCycles();
+        }
+
+        inline void pushScope(internal::Scope_t&& scope)
+        {
+            if (m_locals.size() == m_locals.capacity())
+                ++m_counters.frames_grows;
+            m_locals.push_back(std::move(scope));
+        }
+
+        inline void pushScope(const internal::Scope_t& scope)
+        {
+            if (m_locals.size() == m_locals.capacity())
+                ++m_counters.frames_grows;
+            m_locals.push_back(scope);
+        }
+
+        inline void createNewScope(std::size_t page)
+        {
+            if (!m_scope_pool.empty())
+            {
+                ++m_counters.scopes_reused;
+                m_scope_pool.back()->reset(m_program->scopeLayouts()[page]);
+                pushScope(std::move(m_scope_pool.back()));
+                m_scope_pool.pop_back();
+            }
+            else
+            {
+                ++m_counters.scopes_allocated;
+                pushScope(internal::makeRef<internal::Scope>(m_program->scopeLayouts()[page]));
+            }
+        }
+
+        inline void releaseScope()
+        {
+            // a scope still referenced by a closure can not be reused
+            if (m_locals.back().use_count() == 1)
+            {
+                m_locals.back()->clear();
+                m_scope_pool.push_back(std::move(m_locals.back()));
+            }
+            m_locals.pop_back();
+        }
+
+        inline void pushFrame(std::size_t caller_addr, std::size_t caller_page_addr, std::size_t new_pp, std::size_t stack_base)
+        {
+            if (m_frames.size() == m_frames.capacity())
+                ++m_counters.frames_grows;
+            m_frames.emplace_back(caller_addr, caller_page_addr, new_pp, stack_base);
+            m_fp = stack_base;
+            ++m_counters.calls;
+        }
+
+        inline void createGlobalScope()
+        {
+            // plugins and loadFunction can register any symbol in the global scope
+            m_locals.emplace_back(internal::makeRef<internal::Scope>(m_program->symbols().size()));
         }
 
         // error handling
 
+        inline void checkPointers()
+        {
+            if (m_pp >= m_pages.size())
+                throwVMError("page pointer has gone too far (" + Ark::Utils::toString(m_pp) + ")");
+            if (m_ip < 0 || static_cast<std::size_t>(m_ip) >= pageSize(m_pp))
+                throwVMError("instruction pointer has gone too far (" + Ark::Utils::toString(m_ip) + ")");
+        }
+
+        // address in the bytecode of the current instruction, m_ip being an index in the decoded page
+        inline int currentAddress() const
+        {
+            if (m_program == nullptr || m_pp >= m_program->addresses().size() || m_ip < 0 ||
+                static_cast<std::size_t>(m_ip) >= m_program->addresses()[m_pp].size())
+                return m_ip;
+            return m_program->addresses()[m_pp][m_ip];
+        }
+
         inline void throwVMError(const std::string& message)
         {
             throw std::runtime_error("VMError: " + message);
         }
 
+        // kept out of pop() so that it stays small
+        void stackUnderflowError();
+        // kept out of push() for the same reason
+        void growStack();
+
+        // a string of a single character, shared by all the values holding it instead of allocating one each time
+        inline const internal::Value& character(char c)
+        {
+            if (m_characters.empty())
+                m_characters.resize(256);
+
+            internal::Value& value = m_characters[static_cast<unsigned char>(c)];
+            if (value.valueType() != internal::ValueType::String)
+                value = internal::Value(std::string(1, c));
+            return value;
+        }
+
         // stack management
 
-        inline internal::Value&& pop(int page=-1);
+        inline internal::Value&& pop();
         inline void push(const internal::Value& value);
         inline void push(internal::Value&& value);
 
@@ -216,14 +541,83 @@ namespace Ark
         inline void jump();
         inline void ret();
         inline void call(int16_t argc_=-1);
+        inline void tailCall();
         inline void capture();
         inline void builtin();
         inline void mut();
         inline void del();
         inline void saveEnv();
         inline void getField();
+        inline void loadLocal();
+        inline void storeLocal();
+        inline void loadGlobal();
+        inline void generator();
+        inline void yield();
+
+        // resume a generator, called with 0 or 1 argument (the value of the YIELD it stopped on)
+        inline void resumeGenerator(internal::Value&& generator, uint16_t argc, std::size_t stack_base);
+        // mark the generators being run as finished when leaving them because of an error, the
+        // stacks of their callers being put back
+        inline void stopGenerators(std::size_t count)
+        {
+            while (m_generators.size() > count)
+            {
+                internal::Generator& g = m_generators.back().generator_ref();
+                std::swap(m_stack, g.stack());
+                m_sp = g.callerSp();
+                g.finish();
+                m_generators.pop_back();
+            }
+        }
+
+        template<uint8_t inst>
+        inline void operators();
+        template<uint8_t inst>
+        inline void numberOperators();
+
+        inline std::size_t pageSize(std::size_t page) const
+        {
+            return m_program->pages()[page].size();
+        }
+
+        // replace the current instruction, in the copy of the page owned by the VM
+        inline void rewrite(uint8_t inst)
+        {
+            std::vector<internal::DecodedInst>& page = m_own_pages[m_pp];
+            if (page.empty())
+            {
+                page = m_program->pages()[m_pp];
+                m_pages[m_pp] = page.data();
+            }
+            page[m_ip].inst = inst;
+        }
+
+        // the strings can't be shared with the VMs running on other threads, each VM copies them when loading them
+        inline const internal::Value& stringConstant(uint16_t id)
+        {
+            if (m_string_constants.empty())
+                m_string_constants.resize(m_program->constants().size());
+            internal::Value& copy = m_string_constants[id];
+            if (copy.valueType() != internal::ValueType::String)
+                copy = internal::Transfer().value(m_constants[id]);
+            return copy;
+        }
+
+        template<uint8_t inst>
+        inline void quicken()
+        {
+            // only the operators run from the current instruction are replaced
+            if (m_features & FeatureQuickening)
+                rewrite(inst - internal::Instruction::ADD + internal::Instruction::ADD_NUM);
+        }
 
-        inline void operators(uint8_t inst);
+        // superinstructions
+        template<uint8_t op>
+        inline void loadLocalLoadConstOp();
+        inline void loadGlobalCall();
+        inline void loadGlobalTailCall();
+        inline void loadLocalCall();
+        inline void builtinCall();
     };
 }
 
@@ -1,7 +1,9 @@
 template<bool debug>
-VM_t<debug>::VM_t(bool persist) :
-    m_persist(persist), m_ip(0), m_pp(0), m_running(false), m_filename("FILE"),
-    m_last_sym_loaded(0), m_until_frame_count(0)
+VM_t<debug>::VM_t(bool persist, uint16_t features) :
+    m_persist(persist), m_features(features), m_ip(0), m_pp(0), m_running(false),
+    m_last_sym_loaded(0), m_until_frame_count(0), m_constants(nullptr), m_sp(0), m_fp(0),
+    m_dispatch_count(0), m_native_stack(nullptr), m_native_stack_size(0), m_native_locals(nullptr),
+    m_resumable(false), m_budget(NoBudget), m_run_state(RunState::Finished)
 {}
 
 // ------------------------------------------
@@ -15,11 +17,8 @@ void VM_t<debug>::feed(const std::string& filename)
     {
         Ark::BytecodeReader bcr;
         bcr.feed(filename);
-        m_bytecode = bcr.bytecode();
 
-        m_filename = filename;
-
-        configure();
+        feed(std::make_shared<const Program>(bcr.bytecode(), filename, m_features, debug));
     }
     catch (const std::exception& e)
     {
@@ -30,8 +29,29 @@ void VM_t<debug>::feed(const std::string& filename)
 template<bool debug>
 void VM_t<debug>::feed(const bytecode_t& bytecode)
 {
-    m_bytecode = bytecode;
-    configure();
+    feed(std::make_shared<const Program>(bytecode, "FILE", m_features, debug));
+}
+
+template<bool debug>
+void VM_t<debug>::feed(std::shared_ptr<const Program> program)
+{
+    using namespace Ark::internal;
+
+    m_program = std::move(program);
+
+    // the pages and the constants are read from the program, which can be shared with VMs running on other threads
+    m_pages.clear();
+    for (const auto& page : m_program->pages())
+        m_pages.push_back(page.data());
+    m_own_pages.clear();
+    m_own_pages.resize(m_pages.size());
+    m_constants = m_program->constants().data();
+    m_string_constants.clear();
+
+    // the pages are compiled by the JIT once they're called often enough
+    m_native.clear();
+    m_native.resize(m_pages.size());
+    m_calls_count.assign(m_pages.size(), 0);
 }
 
 static bool compile(bool debug, const std::string& file, const std::string& output)
@@ -94,8 +114,8 @@ void VM_t<debug>::doFile(const std::string& file)
             bcr2.feed(path);
             auto timestamp = bcr2.timestamp();
             auto file_last_write = static_cast<decltype(timestamp)>(std::chrono::duration_cast<std::chrono::seconds>(ftime.time_since_epoch()).count());
-            // recompile
-            if (timestamp < file_last_write)
+            // recompile, also when the bytecode was generated by another version of the compiler
+            if (timestamp < file_last_write || !bcr2.compatible())
                 compiled_successfuly = Ark::compile(debug, file, path);
         }
         else
@@ -113,255 +133,139 @@ void VM_t<debug>::doFile(const std::string& file)
             run();
         }
     }
-    else  // it's a bytecode file, run it
+    else  // it's a bytecode file, run it if it could be loaded (it may come from another version)
     {
         feed(file);
-        run();
+        if (m_program != nullptr)
+            run();
     }
 }
 
 template<bool debug>
-void VM_t<debug>::configure()
+void VM_t<debug>::loadFunction(const std::string& name, internal::Value::ProcType function)
 {
     using namespace Ark::internal;
 
-    // configure tables and pages
-    const bytecode_t& b = m_bytecode;
-    std::size_t i = 0;
-
-    auto readNumber = [&b] (std::size_t& i) -> uint16_t {
-        uint16_t x = (static_cast<uint16_t>(b[i]) << 8); ++i;
-        uint16_t y = static_cast<uint16_t>(b[i]);
-        return x + y;
-    };
-
-    // read tables and check if bytecode is valid
-    if (!(b.size() > 4 && b[i++] == 'a' && b[i++] == 'r' && b[i++] == 'k' && b[i++] == Instruction::NOP))
-        throwVMError("invalid format: couldn't find magic constant");
-
-    if constexpr (debug)
-        Ark::logger.info("(Virtual Machine) magic constant found: ark\\0");
-
-    uint16_t major = readNumber(i); i++;
-    uint16_t minor = readNumber(i); i++;
-    uint16_t patch = readNumber(i); i++;
-
-    if constexpr (debug)
-        Ark::logger.info("(Virtual Machine) version used: ", major, ".", minor, ".", patch);
-    
-    if (major != ARK_VERSION_MAJOR)
+    // put it in the global frame if we can, aka the first one
+    const auto& symbols = m_program->symbols();
+    auto it = std::find(symbols.begin(), symbols.end(), name);
+    if (it == symbols.end())
     {
-        std::string str_version = Ark::Utils::toString(major) + "." +
-            Ark::Utils::toString(minor) + "." +
-            Ark::Utils::toString(patch);
-        std::string builtin_version = Ark::Utils::toString(ARK_VERSION_MAJOR) + "." +
-            Ark::Utils::toString(ARK_VERSION_MINOR) + "." +
-            Ark::Utils::toString(ARK_VERSION_PATCH);
-        throwVMError("Compiler and VM versions don't match: " + str_version + " and " + builtin_version);
+        if constexpr (debug)
+            Ark::logger.warn("Couldn't find symbol with name", name, "to set its value as a function");
+        return;
     }
 
-    using timestamp_t = unsigned long long;
-    timestamp_t timestamp = 0;
-    auto aa = (static_cast<timestamp_t>(m_bytecode[  i]) << 56),
-        ba = (static_cast<timestamp_t>(m_bytecode[++i]) << 48),
-        ca = (static_cast<timestamp_t>(m_bytecode[++i]) << 40),
-        da = (static_cast<timestamp_t>(m_bytecode[++i]) << 32),
-        ea = (static_cast<timestamp_t>(m_bytecode[++i]) << 24),
-        fa = (static_cast<timestamp_t>(m_bytecode[++i]) << 16),
-        ga = (static_cast<timestamp_t>(m_bytecode[++i]) <<  8),
-        ha = (static_cast<timestamp_t>(m_bytecode[++i]));
-    i++;
-    timestamp = aa + ba + ca + da + ea + fa + ga + ha;
+    registerVariable<0>(std::distance(symbols.begin(), it), Value(function));
+}
 
-    if constexpr (debug)
-        Ark::logger.info("(Virtual Machine) timestamp: ", timestamp);
+template<bool debug>
+internal::Value& VM_t<debug>::operator[](const std::string& name)
+{
+    using namespace Ark::internal;
 
-    if (b[i] == Instruction::SYM_TABLE_START)
+    // find id of object
+    const auto& symbols = m_program->symbols();
+    auto it = std::find(symbols.begin(), symbols.end(), name);
+    if (it == symbols.end())
     {
         if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) symbols table");
-        
-        i++;
-        uint16_t size = readNumber(i);
-        m_symbols.reserve(size);
-        i++;
-
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) length:", size);
-        
-        for (uint16_t j=0; j < size; ++j)
-        {
-            std::string symbol = "";
-            while (b[i] != 0)
-                symbol.push_back(b[i++]);
-            i++;
-
-            m_symbols.push_back(symbol);
-
-            if constexpr (debug)
-                Ark::logger.info("(Virtual Machine) -", symbol);
-        }
+            throwVMError("Couldn't find symbol with name " + name);
     }
-    else
-        throwVMError("couldn't find symbols table");
 
-    if (b[i] == Instruction::VAL_TABLE_START)
-    {
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) constants table");
-        
-        i++;
-        uint16_t size = readNumber(i);
-        m_constants.reserve(size);
-        i++;
+    uint16_t id = static_cast<uint16_t>(std::distance(symbols.begin(), it));
+    auto var = findNearestVariable(id);
+    if (var != nullptr)
+        return *var;
+    else
+        throwVMError("Couldn't load symbol with name " + name);
+}
 
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) length:", size);
+// ------------------------------------------
+//                 execution
+// ------------------------------------------
 
-        for (uint16_t j=0; j < size; ++j)
-        {
-            uint8_t type = b[i];
-            i++;
+template<bool debug>
+void VM_t<debug>::run()
+{
+    init();
 
-            if (type == Instruction::NUMBER_TYPE)
-            {
-                std::string val = "";
-                while (b[i] != 0)
-                    val.push_back(b[i++]);
-                i++;
+    if constexpr (debug)
+        Ark::logger.info("Starting at PP:{0}, IP:{1}"s, m_pp, m_ip);
 
-                m_constants.emplace_back(std::stod(val));
-                
-                if constexpr (debug)
-                    Ark::logger.info("(Virtual Machine) - (Number)", val);
-            }
-            else if (type == Instruction::STRING_TYPE)
-            {
-                std::string val = "";
-                while (b[i] != 0)
-                    val.push_back(b[i++]);
-                i++;
+    safeRun();
+}
 
-                m_constants.emplace_back(val);
-                
-                if constexpr (debug)
-                    Ark::logger.info("(Virtual Machine) - (String)", val);
-            }
-            else if (type == Instruction::FUNC_TYPE)
-            {
-                uint16_t addr = readNumber(i);
-                i++;
+template<bool debug>
+RunState VM_t<debug>::start(std::size_t budget)
+{
+    init();
+    m_until_frame_count = 0;
+    return runResumable(budget);
+}
 
-                m_constants.emplace_back(addr);
+template<bool debug>
+RunState VM_t<debug>::startCall(const std::string& name, const std::vector<internal::Value>& args, std::size_t budget)
+{
+    if (m_run_state != RunState::Finished)
+        throwVMError("can not call " + name + ", the VM is paused");
 
-                if constexpr (debug)
-                    Ark::logger.info("(Virtual Machine) - (PageAddr)", addr);
-                
-                i++;  // skip NOP
-            }
-            else
-                throwVMError("unknown value type for value " + Ark::Utils::toString(j));
-        }
-    }
-    else
-        throwVMError("couldn't find constants table");
+    uint16_t id = 0;
+    const internal::Value& function = findFunction(name, id);
 
-    if (b[i] == Instruction::PLUGIN_TABLE_START)
+    m_until_frame_count = m_frames.size();
+    try
     {
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) plugins table");
-        
-        i++;
-        uint16_t size = readNumber(i);
-        m_plugins.reserve(size);
-        i++;
-
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) length:", size);
-        
-        for (uint16_t j=0; j < size; ++j)
-        {
-            std::string plugin = "";
-            while (b[i] != 0)
-                plugin.push_back(b[i++]);
-            i++;
-
-            m_plugins.push_back(plugin);
-
-            if constexpr (debug)
-                Ark::logger.info("(Virtual Machine) -", plugin);
-        }
+        pushCall(function, id, args);
     }
-    else
-        throwVMError("couldn't find plugins table");
-    
-    while (b[i] == Instruction::CODE_SEGMENT_START)
+    catch (...)
     {
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) code segment");
-        
-        i++;
-        uint16_t size = readNumber(i);
-        i++;
-
-        if constexpr (debug)
-            Ark::logger.info("(Virtual Machine) length:", size);
-        
-        m_pages.emplace_back();
-        m_pages.back().reserve(size);
-
-        for (uint16_t j=0; j < size; ++j)
-            m_pages.back().push_back(b[i++]);
-        
-        if (i == b.size())
-            break;
+        reset();
+        throw;
     }
+    return runResumable(budget);
 }
 
 template<bool debug>
-void VM_t<debug>::loadFunction(const std::string& name, internal::Value::ProcType function)
+RunState VM_t<debug>::resume(std::size_t budget)
 {
-    using namespace Ark::internal;
-
-    // put it in the global frame if we can, aka the first one
-    auto it = std::find(m_symbols.begin(), m_symbols.end(), name);
-    if (it == m_symbols.end())
-    {
-        if constexpr (debug)
-            Ark::logger.warn("Couldn't find symbol with name", name, "to set its value as a function");
-        return;
-    }
+    if (m_run_state == RunState::Finished)
+        throwVMError("can not resume the VM, it isn't paused");
+    return runResumable(budget);
+}
 
-    registerVariable<0>(std::distance(m_symbols.begin(), it), Value(function));
+template<bool debug>
+internal::Value VM_t<debug>::result()
+{
+    if (m_run_state != RunState::Finished)
+        throwVMError("the function called didn't return yet");
+    return pop();
 }
 
 template<bool debug>
-internal::Value& VM_t<debug>::operator[](const std::string& name)
+RunState VM_t<debug>::runResumable(std::size_t budget)
 {
-    using namespace Ark::internal;
+    m_resumable = true;
+    m_budget = (budget == 0) ? NoBudget : budget;
 
-    // find id of object
-    auto it = std::find(m_symbols.begin(), m_symbols.end(), name);
-    if (it == m_symbols.end())
+    try
     {
-        if constexpr (debug)
-            throwVMError("Couldn't find symbol with name " + name);
+        safeRun(m_until_frame_count, /* rethrow */ true);
+    }
+    catch (...)
+    {
+        m_resumable = false;
+        m_run_state = RunState::Finished;
+        reset();
+        throw;
     }
 
-    uint16_t id = static_cast<uint16_t>(std::distance(m_symbols.begin(), it));
-    auto var = findNearestVariable(id);
-    if (var != nullptr)
-        return *var;
-    else
-        throwVMError("Couldn't load symbol with name " + name);
+    m_resumable = false;
+    return m_run_state;
 }
 
-// ------------------------------------------
-//                 execution
-// ------------------------------------------
-
 template<bool debug>
-void VM_t<debug>::run()
+void VM_t<debug>::init()
 {
     using namespace Ark::internal;
 
@@ -374,19 +278,26 @@ void VM_t<debug>::run()
         m_frames.clear();
         m_frames.emplace_back();
 
+        stopGenerators(0);
+        for (std::size_t i=0; i < m_sp; ++i)
+            m_stack[i] = Value();
+        m_sp = 0;
+        m_fp = 0;
+
         m_saved_scope.reset();
 
-        m_locals.clear();
-        createNewScope();
+        while (!m_locals.empty())
+            releaseScope();
+        createGlobalScope();
 
         // loading plugins
-        for (const auto& file: m_plugins)
+        for (const auto& file: m_program->plugins())
         {
             namespace fs = std::filesystem;
 
             std::string path = "./" + file;
-            if (m_filename != "FILE")  // bytecode loaded from file
-                path = "./" + (fs::path(m_filename).parent_path() / fs::path(file)).string();
+            if (m_program->filename() != "FILE")  // bytecode loaded from file
+                path = "./" + (fs::path(m_program->filename()).parent_path() / fs::path(file)).string();
             std::string lib_path = (fs::path(ARK_STD) / fs::path(file)).string();
 
             if constexpr (debug)
@@ -407,136 +318,929 @@ void VM_t<debug>::run()
             for (auto&& kv : map)
             {
                 // put it in the global frame, aka the first one
-                auto it = std::find(m_symbols.begin(), m_symbols.end(), kv.first);
-                if (it != m_symbols.end())
+                const auto& symbols = m_program->symbols();
+                auto it = std::find(symbols.begin(), symbols.end(), kv.first);
+                if (it != symbols.end())
                 {
                     if constexpr (debug)
                         Ark::logger.info("Loading", kv.first);
 
-                    registerVariable<0>(std::distance(m_symbols.begin(), it), Value(kv.second));
+                    registerVariable<0>(std::distance(symbols.begin(), it), Value(kv.second));
                 }
             }
         }
     }
+}
 
-    if constexpr (debug)
-        Ark::logger.info("Starting at PP:{0}, IP:{1}"s, m_pp, m_ip);
+template<bool debug>
+std::vector<internal::Value> VM_t<debug>::parallelCall(const internal::Value& function, const internal::List& list)
+{
+    using namespace Ark::internal;
 
-    safeRun();
+    std::vector<Value> results(list.size());
+    if (list.empty())
+        return results;
+
+    std::size_t workers = std::min<std::size_t>(list.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::size_t chunk = (list.size() + workers - 1) / workers;
+    workers = (list.size() + chunk - 1) / chunk;
+
+    // the workers give the function the symbol it would have been given if it was called by its name
+    uint16_t id = findNearestVariableIdWithValue(Value(function));
+
+    std::vector<std::exception_ptr> errors(workers);
+    std::atomic<bool> failed = false;
+
+    auto work = [&](std::size_t worker) {
+        try
+        {
+            VM_t<debug> vm(/* persist */ false, m_features);
+            vm.feed(m_program);
+            vm.m_frames.emplace_back();
+
+            // the workers start from a deep copy of the global scope and of the function, the closures
+            // being given a copy of their captured scope: they never modify the same variables, and
+            // never share a refcount. The values of the current thread are only read
+            Transfer transfer;
+            vm.m_locals.push_back(transfer.scope(*m_locals.front()));
+            Value fn = transfer.value(function);
+
+            std::vector<Value> args(1);
+            for (std::size_t i=worker * chunk, end=std::min(list.size(), i + chunk); i < end && !failed; ++i)
+            {
+                args[0] = transfer.value(list[i]);
+                results[i] = vm.callFunction(fn, id, args);
+            }
+        }
+        catch (...)
+        {
+            errors[worker] = std::current_exception();
+            failed = true;
+        }
+    };
+
+    // the current thread runs the first chunk
+    std::vector<std::thread> threads;
+    for (std::size_t worker=1; worker < workers; ++worker)
+        threads.emplace_back(work, worker);
+    work(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    return results;
+}
+
+template<bool debug>
+void VM_t<debug>::saveGlobals()
+{
+    using namespace Ark::internal;
+
+    if (m_locals.empty())
+        return;
+
+    // the strings and the lists are copied on write, the calls can't modify the values saved. The objects
+    // modified in place are copied, the saved closures would share their scopes with the ones used by the calls
+    m_saved_globals = *m_locals.front();
+    m_mutable_globals.clear();
+    Transfer transfer;
+    for (std::size_t i=0, end=m_saved_globals->size(); i < end; ++i)
+    {
+        if (modifiedInPlace(m_saved_globals->slot(i)))
+        {
+            m_mutable_globals.push_back(i);
+            m_saved_globals->slot(i) = transfer.value(m_saved_globals->slot(i));
+        }
+    }
 }
 
 template<bool debug>
-void VM_t<debug>::safeRun(std::size_t untilFrameCount)
+bool VM_t<debug>::modifiedInPlace(const internal::Value& value)
+{
+    using namespace Ark::internal;
+
+    switch (value.valueType())
+    {
+        case ValueType::Closure:
+        case ValueType::Generator:
+        case ValueType::StringBuilder:
+            return true;
+
+        case ValueType::List:
+            return std::any_of(value.const_list().begin(), value.const_list().end(), modifiedInPlace);
+
+        default:
+            return false;
+    }
+}
+
+template<bool debug>
+void VM_t<debug>::reset()
+{
+    using namespace Ark::internal;
+
+    m_ip = 0;
+    m_pp = 0;
+    m_running = false;
+
+    m_frames.clear();
+    m_frames.emplace_back();
+
+    stopGenerators(0);
+    for (std::size_t i=0; i < m_sp; ++i)
+        m_stack[i] = Value();
+    m_sp = 0;
+    m_fp = 0;
+
+    m_saved_scope.reset();
+
+    while (m_locals.size() > 1)
+        releaseScope();
+    if (m_locals.empty())
+        createGlobalScope();
+    else if (m_saved_globals)
+    {
+        // the calls may have modified the scopes of the global closures, the generators and the builders,
+        // which are copied again, once for all the values sharing them
+        Scope& globals = *m_locals.front();
+        globals = m_saved_globals.value();
+        Transfer transfer;
+        for (std::size_t i : m_mutable_globals)
+            globals.slot(i) = transfer.value(globals.slot(i));
+
+        // like the originals, the copies of the scopes can be part of cycles
+        for (const auto& [original, scope] : transfer.scopes())
+            trackScope(scope);
+    }
+}
+
+template<bool debug>
+void VM_t<debug>::safeRun(std::size_t untilFrameCount, bool rethrow)
 {
     using namespace Ark::internal;
     m_until_frame_count = untilFrameCount;
+    m_run_state = RunState::Finished;
+
+    // the budget is given by runResumable for this run only
+    std::size_t budget = m_budget;
+    m_budget = NoBudget;
+    // the instructions run as native code can't be counted
+    const bool use_native = (m_features & FeatureJIT) && budget == NoBudget;
     
     try {
         m_running = true;
-        while (m_running)
+
+#ifdef ARK_PROFILER
+    #define ARK_COUNT_DISPATCH() ++m_dispatch_count
+#else
+    #define ARK_COUNT_DISPATCH()
+#endif
+
+    // after the instructions which can change of page, continue in native code if it was compiled
+    #define ARK_RUN_NATIVE()                                            \
+        if (use_native)                                                 \
+            runNative()
+
+#ifdef ARK_USE_COMPUTED_GOTO
+        if (m_features & FeatureComputedGoto)
         {
-            if constexpr (debug)
+            /*
+                Direct threaded dispatch: every handler jumps straight to the handler
+                of the next instruction, through a table of labels indexed by opcode.
+                Only the handlers able to stop the VM (RET, HALT) check m_running.
+                The addresses of the labels don't change from a run to another: the table
+                is filled once, by the first run (the VMs of a pool may start it concurrently).
+            */
+            static void* dispatch_table[256];
+            static std::atomic<bool> dispatch_table_filled = false;
+            if (!dispatch_table_filled.load(std::memory_order_acquire))
             {
-                if (m_pp >= m_pages.size())
-                    throwVMError("page pointer has gone too far (" + Ark::Utils::toString(m_pp) + ")");
-                if (m_ip >= m_pages[m_pp].size())
-                    throwVMError("instruction pointer has gone too far (" + Ark::Utils::toString(m_ip) + ")");
+                static std::mutex dispatch_table_mutex;
+                std::lock_guard<std::mutex> lock(dispatch_table_mutex);
+
+                if (!dispatch_table_filled.load(std::memory_order_relaxed))
+                {
+                    for (auto& target : dispatch_table)
+                        target = &&label_unknown;
+
+                    dispatch_table[Instruction::NOP] = &&label_nop;
+                    dispatch_table[Instruction::LOAD_SYMBOL] = &&label_load_symbol;
+                    dispatch_table[Instruction::LOAD_CONST] = &&label_load_const;
+                    dispatch_table[Instruction::POP_JUMP_IF_TRUE] = &&label_pop_jump_if_true;
+                    dispatch_table[Instruction::STORE] = &&label_store;
+                    dispatch_table[Instruction::LET] = &&label_let;
+                    dispatch_table[Instruction::POP_JUMP_IF_FALSE] = &&label_pop_jump_if_false;
+                    dispatch_table[Instruction::JUMP] = &&label_jump;
+                    dispatch_table[Instruction::RET] = &&label_ret;
+                    dispatch_table[Instruction::HALT] = &&label_halt;
+                    dispatch_table[Instruction::CALL] = &&label_call;
+                    dispatch_table[Instruction::CAPTURE] = &&label_capture;
+                    dispatch_table[Instruction::BUILTIN] = &&label_builtin;
+                    dispatch_table[Instruction::MUT] = &&label_mut;
+                    dispatch_table[Instruction::DEL] = &&label_del;
+                    dispatch_table[Instruction::SAVE_ENV] = &&label_save_env;
+                    dispatch_table[Instruction::GET_FIELD] = &&label_get_field;
+                    dispatch_table[Instruction::LOAD_LOCAL] = &&label_load_local;
+                    dispatch_table[Instruction::STORE_LOCAL] = &&label_store_local;
+                    dispatch_table[Instruction::LOAD_GLOBAL] = &&label_load_global;
+                    dispatch_table[Instruction::TAIL_CALL] = &&label_tail_call;
+                    dispatch_table[Instruction::GENERATOR] = &&label_generator;
+                    dispatch_table[Instruction::YIELD] = &&label_yield;
+                    dispatch_table[Instruction::ADD] = &&label_add;
+                    dispatch_table[Instruction::SUB] = &&label_sub;
+                    dispatch_table[Instruction::MUL] = &&label_mul;
+                    dispatch_table[Instruction::DIV] = &&label_div;
+                    dispatch_table[Instruction::GT] = &&label_gt;
+                    dispatch_table[Instruction::LT] = &&label_lt;
+                    dispatch_table[Instruction::LE] = &&label_le;
+                    dispatch_table[Instruction::GE] = &&label_ge;
+                    dispatch_table[Instruction::NEQ] = &&label_neq;
+                    dispatch_table[Instruction::EQ] = &&label_eq;
+                    dispatch_table[Instruction::LEN] = &&label_len;
+                    dispatch_table[Instruction::EMPTY] = &&label_empty;
+                    dispatch_table[Instruction::FIRSTOF] = &&label_firstof;
+                    dispatch_table[Instruction::TAILOF] = &&label_tailof;
+                    dispatch_table[Instruction::HEADOF] = &&label_headof;
+                    dispatch_table[Instruction::ISNIL] = &&label_isnil;
+                    dispatch_table[Instruction::ASSERT] = &&label_assert;
+                    dispatch_table[Instruction::TO_NUM] = &&label_to_num;
+                    dispatch_table[Instruction::TO_STR] = &&label_to_str;
+                    dispatch_table[Instruction::AT] = &&label_at;
+                    dispatch_table[Instruction::AND_] = &&label_and_;
+                    dispatch_table[Instruction::OR_] = &&label_or_;
+                    dispatch_table[Instruction::MOD] = &&label_mod;
+                    dispatch_table[Instruction::TYPE] = &&label_type;
+                    dispatch_table[Instruction::HASFIELD] = &&label_hasfield;
+                    dispatch_table[Instruction::PMAP] = &&label_pmap;
+                    dispatch_table[Instruction::PFOREACH] = &&label_pforeach;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_ADD] = &&label_load_local_load_const_add;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_SUB] = &&label_load_local_load_const_sub;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_MUL] = &&label_load_local_load_const_mul;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_DIV] = &&label_load_local_load_const_div;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_GT] = &&label_load_local_load_const_gt;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_LT] = &&label_load_local_load_const_lt;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_LE] = &&label_load_local_load_const_le;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_GE] = &&label_load_local_load_const_ge;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_NEQ] = &&label_load_local_load_const_neq;
+                    dispatch_table[Instruction::LOAD_LOCAL_LOAD_CONST_EQ] = &&label_load_local_load_const_eq;
+                    dispatch_table[Instruction::LOAD_GLOBAL_CALL] = &&label_load_global_call;
+                    dispatch_table[Instruction::LOAD_GLOBAL_TAIL_CALL] = &&label_load_global_tail_call;
+                    dispatch_table[Instruction::LOAD_LOCAL_CALL] = &&label_load_local_call;
+                    dispatch_table[Instruction::BUILTIN_CALL] = &&label_builtin_call;
+                    dispatch_table[Instruction::ADD_NUM] = &&label_add_num;
+                    dispatch_table[Instruction::SUB_NUM] = &&label_sub_num;
+                    dispatch_table[Instruction::MUL_NUM] = &&label_mul_num;
+                    dispatch_table[Instruction::DIV_NUM] = &&label_div_num;
+                    dispatch_table[Instruction::GT_NUM] = &&label_gt_num;
+                    dispatch_table[Instruction::LT_NUM] = &&label_lt_num;
+                    dispatch_table[Instruction::LE_NUM] = &&label_le_num;
+                    dispatch_table[Instruction::GE_NUM] = &&label_ge_num;
+                    dispatch_table[Instruction::NEQ_NUM] = &&label_neq_num;
+                    dispatch_table[Instruction::EQ_NUM] = &&label_eq_num;
+
+                    dispatch_table_filled.store(true, std::memory_order_release);
+                }
             }
 
-            // get current instruction
-            uint8_t inst = m_pages[m_pp][m_ip];
+            #define ARK_DISPATCH_CURRENT()                                  \
+                {                                                           \
+                    if constexpr (debug)                                    \
+                        checkPointers();                                    \
+                    ARK_COUNT_DISPATCH();                                   \
+                    if (budget-- == 0)                                      \
+                        goto label_out_of_budget;                           \
+                    goto *dispatch_table[m_pages[m_pp][m_ip].inst];         \
+                }
+            #define ARK_DISPATCH()                                          \
+                {                                                           \
+                    ++m_ip;                                                 \
+                    ARK_DISPATCH_CURRENT();                                 \
+                }
+            #define ARK_DISPATCH_OR_STOP()                                  \
+                {                                                           \
+                    ++m_ip;                                                 \
+                    if (!m_running)                                         \
+                        goto label_stop;                                    \
+                    ARK_DISPATCH_CURRENT();                                 \
+                }
+            // after a call, which may have paused the VM if it called (yieldToHost)
+            #define ARK_DISPATCH_NATIVE()                                   \
+                {                                                           \
+                    ARK_RUN_NATIVE();                                       \
+                    ARK_DISPATCH_OR_STOP();                                 \
+                }
 
-            // and it's time to du-du-du-du-duel!
-            if (inst == Instruction::NOP)
+            // the first page may already be native code
+            if (use_native && m_native[m_pp].function() != nullptr)
             {
+                --m_ip;
+                runNative();
+                ARK_DISPATCH_OR_STOP();
+            }
+            ARK_DISPATCH_CURRENT();
+
+            label_nop:
                 if constexpr (debug)
                     Ark::logger.info("NOP PP:{0}, IP:{1}"s, m_pp, m_ip);
+                ARK_DISPATCH();
+            label_load_symbol:
+                loadSymbol();
+                ARK_DISPATCH();
+            label_load_const:
+                loadConst();
+                ARK_DISPATCH();
+            label_pop_jump_if_true:
+                popJumpIfTrue();
+                ARK_DISPATCH();
+            label_store:
+                store();
+                ARK_DISPATCH();
+            label_let:
+                let();
+                ARK_DISPATCH();
+            label_pop_jump_if_false:
+                popJumpIfFalse();
+                ARK_DISPATCH();
+            label_jump:
+                jump();
+                ARK_DISPATCH();
+            label_ret:
+                ret();
+                ARK_RUN_NATIVE();
+                ARK_DISPATCH_OR_STOP();
+            label_halt:
+                m_running = false;
+                ARK_DISPATCH_OR_STOP();
+            label_call:
+                call();
+                ARK_DISPATCH_NATIVE();
+            label_capture:
+                capture();
+                ARK_DISPATCH();
+            label_builtin:
+                builtin();
+                ARK_DISPATCH();
+            label_mut:
+                mut();
+                ARK_DISPATCH();
+            label_del:
+                del();
+                ARK_DISPATCH();
+            label_save_env:
+                saveEnv();
+                ARK_DISPATCH();
+            label_get_field:
+                getField();
+                ARK_DISPATCH();
+            label_load_local:
+                loadLocal();
+                ARK_DISPATCH();
+            label_store_local:
+                storeLocal();
+                ARK_DISPATCH();
+            label_load_global:
+                loadGlobal();
+                ARK_DISPATCH();
+            label_tail_call:
+                tailCall();
+                ARK_DISPATCH_NATIVE();
+            label_generator:
+                generator();
+                ARK_RUN_NATIVE();
+                ARK_DISPATCH_OR_STOP();
+            label_yield:
+                yield();
+                ARK_RUN_NATIVE();
+                ARK_DISPATCH_OR_STOP();
+            label_add:
+                operators<Instruction::ADD>();
+                ARK_DISPATCH();
+            label_sub:
+                operators<Instruction::SUB>();
+                ARK_DISPATCH();
+            label_mul:
+                operators<Instruction::MUL>();
+                ARK_DISPATCH();
+            label_div:
+                operators<Instruction::DIV>();
+                ARK_DISPATCH();
+            label_gt:
+                operators<Instruction::GT>();
+                ARK_DISPATCH();
+            label_lt:
+                operators<Instruction::LT>();
+                ARK_DISPATCH();
+            label_le:
+                operators<Instruction::LE>();
+                ARK_DISPATCH();
+            label_ge:
+                operators<Instruction::GE>();
+                ARK_DISPATCH();
+            label_neq:
+                operators<Instruction::NEQ>();
+                ARK_DISPATCH();
+            label_eq:
+                operators<Instruction::EQ>();
+                ARK_DISPATCH();
+            label_len:
+                operators<Instruction::LEN>();
+                ARK_DISPATCH();
+            label_empty:
+                operators<Instruction::EMPTY>();
+                ARK_DISPATCH();
+            label_firstof:
+                operators<Instruction::FIRSTOF>();
+                ARK_DISPATCH();
+            label_tailof:
+                operators<Instruction::TAILOF>();
+                ARK_DISPATCH();
+            label_headof:
+                operators<Instruction::HEADOF>();
+                ARK_DISPATCH();
+            label_isnil:
+                operators<Instruction::ISNIL>();
+                ARK_DISPATCH();
+            label_assert:
+                operators<Instruction::ASSERT>();
+                ARK_DISPATCH();
+            label_to_num:
+                operators<Instruction::TO_NUM>();
+                ARK_DISPATCH();
+            label_to_str:
+                operators<Instruction::TO_STR>();
+                ARK_DISPATCH();
+            label_at:
+                operators<Instruction::AT>();
+                ARK_DISPATCH();
+            label_and_:
+                operators<Instruction::AND_>();
+                ARK_DISPATCH();
+            label_or_:
+                operators<Instruction::OR_>();
+                ARK_DISPATCH();
+            label_mod:
+                operators<Instruction::MOD>();
+                ARK_DISPATCH();
+            label_type:
+                operators<Instruction::TYPE>();
+                ARK_DISPATCH();
+            label_hasfield:
+                operators<Instruction::HASFIELD>();
+                ARK_DISPATCH();
+            label_pmap:
+                operators<Instruction::PMAP>();
+                ARK_DISPATCH();
+            label_pforeach:
+                operators<Instruction::PFOREACH>();
+                ARK_DISPATCH();
+            label_load_local_load_const_add:
+                loadLocalLoadConstOp<Instruction::ADD>();
+                ARK_DISPATCH();
+            label_load_local_load_const_sub:
+                loadLocalLoadConstOp<Instruction::SUB>();
+                ARK_DISPATCH();
+            label_load_local_load_const_mul:
+                loadLocalLoadConstOp<Instruction::MUL>();
+                ARK_DISPATCH();
+            label_load_local_load_const_div:
+                loadLocalLoadConstOp<Instruction::DIV>();
+                ARK_DISPATCH();
+            label_load_local_load_const_gt:
+                loadLocalLoadConstOp<Instruction::GT>();
+                ARK_DISPATCH();
+            label_load_local_load_const_lt:
+                loadLocalLoadConstOp<Instruction::LT>();
+                ARK_DISPATCH();
+            label_load_local_load_const_le:
+                loadLocalLoadConstOp<Instruction::LE>();
+                ARK_DISPATCH();
+            label_load_local_load_const_ge:
+                loadLocalLoadConstOp<Instruction::GE>();
+                ARK_DISPATCH();
+            label_load_local_load_const_neq:
+                loadLocalLoadConstOp<Instruction::NEQ>();
+                ARK_DISPATCH();
+            label_load_local_load_const_eq:
+                loadLocalLoadConstOp<Instruction::EQ>();
+                ARK_DISPATCH();
+            label_load_global_call:
+                loadGlobalCall();
+                ARK_DISPATCH_NATIVE();
+            label_load_global_tail_call:
+                loadGlobalTailCall();
+                ARK_DISPATCH_NATIVE();
+            label_load_local_call:
+                loadLocalCall();
+                ARK_DISPATCH_NATIVE();
+            label_builtin_call:
+                builtinCall();
+                ARK_DISPATCH_OR_STOP();
+            label_add_num:
+                numberOperators<Instruction::ADD>();
+                ARK_DISPATCH();
+            label_sub_num:
+                numberOperators<Instruction::SUB>();
+                ARK_DISPATCH();
+            label_mul_num:
+                numberOperators<Instruction::MUL>();
+                ARK_DISPATCH();
+            label_div_num:
+                numberOperators<Instruction::DIV>();
+                ARK_DISPATCH();
+            label_gt_num:
+                numberOperators<Instruction::GT>();
+                ARK_DISPATCH();
+            label_lt_num:
+                numberOperators<Instruction::LT>();
+                ARK_DISPATCH();
+            label_le_num:
+                numberOperators<Instruction::LE>();
+                ARK_DISPATCH();
+            label_ge_num:
+                numberOperators<Instruction::GE>();
+                ARK_DISPATCH();
+            label_neq_num:
+                numberOperators<Instruction::NEQ>();
+                ARK_DISPATCH();
+            label_eq_num:
+                numberOperators<Instruction::EQ>();
+                ARK_DISPATCH();
+            label_unknown:
+                throwVMError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(m_pages[m_pp][m_ip].inst)) +
+                    ", pp: " + Ark::Utils::toString(m_pp) + ", ip: " + Ark::Utils::toString(currentAddress())
+                );
+
+            label_out_of_budget:
+                // the instruction at m_ip wasn't run, it will be the first one when resuming
+                m_run_state = RunState::OutOfBudget;
+
+            label_stop:
+                ;
+
+            #undef ARK_DISPATCH_NATIVE
+            #undef ARK_DISPATCH_OR_STOP
+            #undef ARK_DISPATCH
+            #undef ARK_DISPATCH_CURRENT
+        }
+        else
+#endif
+        {
+            // switch dispatch, when the compiler can't jump to a label address or FeatureComputedGoto is disabled
+            // the first page may already be native code
+            if (use_native && m_native[m_pp].function() != nullptr)
+            {
+                --m_ip;
+                runNative();
+                ++m_ip;
             }
-            else if (Instruction::FIRST_COMMAND <= inst && inst <= Instruction::LAST_COMMAND)
+
+            while (m_running)
+            {
+                if constexpr (debug)
+                    checkPointers();
+                ARK_COUNT_DISPATCH();
+
+                if (budget-- == 0)
+                {
+                    // the instruction at m_ip wasn't run, it will be the first one when resuming
+                    m_run_state = RunState::OutOfBudget;
+                    break;
+                }
+
+                // get current instruction
+                uint8_t inst = m_pages[m_pp][m_ip].inst;
+
+                // and it's time to du-du-du-du-duel!
                 switch (inst)
                 {
+                case Instruction::NOP:
+                    if constexpr (debug)
+                        Ark::logger.info("NOP PP:{0}, IP:{1}"s, m_pp, m_ip);
+                    break;
+
                 case Instruction::LOAD_SYMBOL:
                     loadSymbol();
                     break;
-                
+            
                 case Instruction::LOAD_CONST:
                     loadConst();
                     break;
-                
+            
                 case Instruction::POP_JUMP_IF_TRUE:
                     popJumpIfTrue();
                     break;
-                
+            
                 case Instruction::STORE:
                     store();
                     break;
-                
+            
                 case Instruction::LET:
                     let();
                     break;
-                
+            
                 case Instruction::POP_JUMP_IF_FALSE:
                     popJumpIfFalse();
                     break;
-                
+            
                 case Instruction::JUMP:
                     jump();
                     break;
-                
+            
                 case Instruction::RET:
                     ret();
+                    ARK_RUN_NATIVE();
                     break;
-                
+            
                 case Instruction::HALT:
                     m_running = false;
                     break;
-                
+            
                 case Instruction::CALL:
                     call();
+                    ARK_RUN_NATIVE();
                     break;
-                
+            
                 case Instruction::CAPTURE:
                     capture();
                     break;
-                
+            
                 case Instruction::BUILTIN:
                     builtin();
                     break;
-                
+            
                 case Instruction::MUT:
                     mut();
                     break;
-                
+            
                 case Instruction::DEL:
                     del();
                     break;
-                
+            
                 case Instruction::SAVE_ENV:
                     saveEnv();
                     break;
-                
+            
                 case Instruction::GET_FIELD:
                     getField();
                     break;
-                
+            
+                case Instruction::LOAD_LOCAL:
+                    loadLocal();
+                    break;
+            
+                case Instruction::STORE_LOCAL:
+                    storeLocal();
+                    break;
+            
+                case Instruction::LOAD_GLOBAL:
+                    loadGlobal();
+                    break;
+            
+                case Instruction::TAIL_CALL:
+                    tailCall();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::GENERATOR:
+                    generator();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::YIELD:
+                    yield();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::ADD:
+                    operators<Instruction::ADD>();
+                    break;
+            
+                case Instruction::SUB:
+                    operators<Instruction::SUB>();
+                    break;
+            
+                case Instruction::MUL:
+                    operators<Instruction::MUL>();
+                    break;
+            
+                case Instruction::DIV:
+                    operators<Instruction::DIV>();
+                    break;
+            
+                case Instruction::GT:
+                    operators<Instruction::GT>();
+                    break;
+            
+                case Instruction::LT:
+                    operators<Instruction::LT>();
+                    break;
+            
+                case Instruction::LE:
+                    operators<Instruction::LE>();
+                    break;
+            
+                case Instruction::GE:
+                    operators<Instruction::GE>();
+                    break;
+            
+                case Instruction::NEQ:
+                    operators<Instruction::NEQ>();
+                    break;
+            
+                case Instruction::EQ:
+                    operators<Instruction::EQ>();
+                    break;
+            
+                case Instruction::LEN:
+                    operators<Instruction::LEN>();
+                    break;
+            
+                case Instruction::EMPTY:
+                    operators<Instruction::EMPTY>();
+                    break;
+            
+                case Instruction::FIRSTOF:
+                    operators<Instruction::FIRSTOF>();
+                    break;
+            
+                case Instruction::TAILOF:
+                    operators<Instruction::TAILOF>();
+                    break;
+            
+                case Instruction::HEADOF:
+                    operators<Instruction::HEADOF>();
+                    break;
+            
+                case Instruction::ISNIL:
+                    operators<Instruction::ISNIL>();
+                    break;
+            
+                case Instruction::ASSERT:
+                    operators<Instruction::ASSERT>();
+                    break;
+            
+                case Instruction::TO_NUM:
+                    operators<Instruction::TO_NUM>();
+                    break;
+            
+                case Instruction::TO_STR:
+                    operators<Instruction::TO_STR>();
+                    break;
+            
+                case Instruction::AT:
+                    operators<Instruction::AT>();
+                    break;
+            
+                case Instruction::AND_:
+                    operators<Instruction::AND_>();
+                    break;
+            
+                case Instruction::OR_:
+                    operators<Instruction::OR_>();
+                    break;
+            
+                case Instruction::MOD:
+                    operators<Instruction::MOD>();
+                    break;
+            
+                case Instruction::TYPE:
+                    operators<Instruction::TYPE>();
+                    break;
+            
+                case Instruction::HASFIELD:
+                    operators<Instruction::HASFIELD>();
+                    break;
+            
+                case Instruction::PMAP:
+                    operators<Instruction::PMAP>();
+                    break;
+            
+                case Instruction::PFOREACH:
+                    operators<Instruction::PFOREACH>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_ADD:
+                    loadLocalLoadConstOp<Instruction::ADD>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_SUB:
+                    loadLocalLoadConstOp<Instruction::SUB>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_MUL:
+                    loadLocalLoadConstOp<Instruction::MUL>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_DIV:
+                    loadLocalLoadConstOp<Instruction::DIV>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_GT:
+                    loadLocalLoadConstOp<Instruction::GT>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_LT:
+                    loadLocalLoadConstOp<Instruction::LT>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_LE:
+                    loadLocalLoadConstOp<Instruction::LE>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_GE:
+                    loadLocalLoadConstOp<Instruction::GE>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_NEQ:
+                    loadLocalLoadConstOp<Instruction::NEQ>();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_LOAD_CONST_EQ:
+                    loadLocalLoadConstOp<Instruction::EQ>();
+                    break;
+            
+                case Instruction::LOAD_GLOBAL_CALL:
+                    loadGlobalCall();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::LOAD_GLOBAL_TAIL_CALL:
+                    loadGlobalTailCall();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::LOAD_LOCAL_CALL:
+                    loadLocalCall();
+                    ARK_RUN_NATIVE();
+                    break;
+            
+                case Instruction::BUILTIN_CALL:
+                    builtinCall();
+                    break;
+            
+                case Instruction::ADD_NUM:
+                    numberOperators<Instruction::ADD>();
+                    break;
+            
+                case Instruction::SUB_NUM:
+                    numberOperators<Instruction::SUB>();
+                    break;
+            
+                case Instruction::MUL_NUM:
+                    numberOperators<Instruction::MUL>();
+                    break;
+            
+                case Instruction::DIV_NUM:
+                    numberOperators<Instruction::DIV>();
+                    break;
+            
+                case Instruction::GT_NUM:
+                    numberOperators<Instruction::GT>();
+                    break;
+            
+                case Instruction::LT_NUM:
+                    numberOperators<Instruction::LT>();
+                    break;
+            
+                case Instruction::LE_NUM:
+                    numberOperators<Instruction::LE>();
+                    break;
+            
+                case Instruction::GE_NUM:
+                    numberOperators<Instruction::GE>();
+                    break;
+            
+                case Instruction::NEQ_NUM:
+                    numberOperators<Instruction::NEQ>();
+                    break;
+            
+                case Instruction::EQ_NUM:
+                    numberOperators<Instruction::EQ>();
+                    break;
+            
                 default:
                     throwVMError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(inst)) +
-                        ", pp: " +Ark::Utils::toString(m_pp) + ", ip: " + Ark::Utils::toString(m_ip)
+                        ", pp: " + Ark::Utils::toString(m_pp) + ", ip: " + Ark::Utils::toString(currentAddress())
                     );
                 }
-            else if (Instruction::FIRST_OPERATOR <= inst && inst <= Instruction::LAST_OPERATOR)
-                operators(inst);
-            else
-                throwVMError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(inst)) +
-                    ", pp: " + Ark::Utils::toString(m_pp) + ", ip: " + Ark::Utils::toString(m_ip)
-                );
             
-            // move forward
-            ++m_ip;
+                // move forward
+                ++m_ip;
+            }
         }
+
+#undef ARK_RUN_NATIVE
+#undef ARK_COUNT_DISPATCH
     } catch (const std::exception& e) {
+        if (rethrow)
+            throw;
+
         std::cerr << "\n" << termcolor::red << e.what() << "\n";
-        std::cerr << termcolor::reset << "At IP: " << m_ip << ", PP: " << m_pp << "\n";
+        std::cerr << termcolor::reset << "At IP: " << currentAddress() << ", PP: " << m_pp << "\n";
 
         if (m_frames.size() > 1)
         {
@@ -550,7 +1254,7 @@ void VM_t<debug>::safeRun(std::size_t untilFrameCount)
                         Value(static_cast<PageAddr_t>(it->currentPageAddr()))
                     );
                     
-                    std::cerr << "In function `" << termcolor::green << m_symbols[id] << termcolor::reset << "'\n";
+                    std::cerr << "In function `" << termcolor::green << m_program->symbols()[id] << termcolor::reset << "'\n";
                 }
                 else
                     std::cerr << "In global scope\n";
@@ -563,6 +1267,9 @@ void VM_t<debug>::safeRun(std::size_t untilFrameCount)
             }
         }
     } catch (...) {
+        if (rethrow)
+            throw;
+
         std::cerr << "Unknown error" << std::endl;
     }
 }
@@ -572,23 +1279,62 @@ void VM_t<debug>::safeRun(std::size_t untilFrameCount)
 // ------------------------------------------
 
 template<bool debug>
-inline internal::Value&& VM_t<debug>::pop(int page)
+inline internal::Value&& VM_t<debug>::pop()
+{
+    // a frame can not take the values of its caller
+    if (m_sp == m_fp)
+        stackUnderflowError();
+
+    --m_sp;
+    return std::move(m_stack[m_sp]);
+}
+
+template<bool debug>
+void VM_t<debug>::stackUnderflowError()
 {
-    if (page == -1)
-        return m_frames.back().pop();
-    return m_frames[static_cast<std::size_t>(page)].pop();
+    throwVMError("can not pop a value from an empty stack (missing arguments?)");
+}
+
+template<bool debug>
+void VM_t<debug>::growStack()
+{
+    // the stack is allocated when the VM first pushes a value, a VM which is never run doesn't allocate it
+    if (m_stack.empty())
+        m_stack.resize(ARK_VM_STACK_SIZE);
+    else
+    {
+        m_stack.resize(m_stack.size() * 2);
+        ++m_counters.stack_grows;
+    }
 }
 
 template<bool debug>
 void VM_t<debug>::push(const internal::Value& value)
 {
-    m_frames.back().push(value);
+    if (m_sp == m_stack.size())
+    {
+        // the value may be in the stack, copy it before growing the stack
+        internal::Value copy(value);
+        growStack();
+        m_stack[m_sp] = std::move(copy);
+    }
+    else
+        m_stack[m_sp] = value;
+    ++m_sp;
 }
 
 template<bool debug>
 inline void VM_t<debug>::push(internal::Value&& value)
 {
-    m_frames.back().push(std::move(value));
+    if (m_sp == m_stack.size())
+    {
+        internal::Value moved(std::move(value));
+        growStack();
+        m_stack[m_sp] = std::move(moved);
+    }
+    else
+        m_stack[m_sp] = std::move(value);
+    ++m_sp;
 }
 
 // ------------------------------------------
@@ -602,11 +1348,10 @@ inline void VM_t<debug>::loadSymbol()
         Argument: symbol id (two bytes, big endian)
         Job: Load a symbol from its id onto the stack
     */
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("LOAD_SYMBOL ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("LOAD_SYMBOL ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
 
     auto var = findNearestVariable(id);
     if (var != nullptr)
@@ -616,7 +1361,7 @@ inline void VM_t<debug>::loadSymbol()
         return;
     }
 
-    throwVMError("couldn't find symbol to load: " + m_symbols[id]);
+    throwVMError("couldn't find symbol to load: " + m_program->symbols()[id]);
 }
 
 template<bool debug>
@@ -629,19 +1374,23 @@ inline void VM_t<debug>::loadConst()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
         Ark::logger.info("LOAD_CONST ({0}) PP:{1}, IP:{2}"s, m_constants[id], m_pp, m_ip);
     
-    if (m_saved_scope && m_constants[id].valueType() == ValueType::PageAddr)
+    const Value& constant = m_constants[id];
+    if (m_saved_scope && constant.valueType() == ValueType::PageAddr)
     {
-        push(Value(Closure(m_saved_scope.value(), m_constants[id].pageAddr())));
+        push(Value(Closure(m_saved_scope.value(), constant.pageAddr())));
+        trackScope(m_saved_scope.value());
         m_saved_scope.reset();
     }
+    // the other constants aren't boxed, they are copied without touching a refcount
+    else if (constant.valueType() == ValueType::String)
+        push(stringConstant(id));
     else
-        push(m_constants[id]);
+        push(constant);
 }
 
 template<bool debug>
@@ -654,8 +1403,7 @@ inline void VM_t<debug>::popJumpIfTrue()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
-    int16_t addr = static_cast<int16_t>(readNumber());
+    uint16_t addr = readNumber();
 
     if constexpr (debug)
         Ark::logger.info("POP_JUMP_IF_TRUE ({0}) PP:{1}, IP:{2}"s, addr, m_pp, m_ip);
@@ -675,22 +1423,21 @@ inline void VM_t<debug>::store()
     */
     using namespace Ark::internal;
     
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("STORE ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("STORE ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
 
     auto var = findNearestVariable(id);
     if (var != nullptr)
     {
         if (var->isConst())
-            throwVMError("can not modify a constant: " + m_symbols[id]);
+            throwVMError("can not modify a constant: " + m_program->symbols()[id]);
         *var = pop();
         return;
     }
 
-    throwVMError("couldn't find symbol: " + m_symbols[id]);
+    throwVMError("couldn't find symbol: " + m_program->symbols()[id]);
 }
 
 template<bool debug>
@@ -703,14 +1450,14 @@ inline void VM_t<debug>::let()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("LET ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("LET ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
     
     // check if we are redefining a variable
-    if (getVariableInScope(id) != FFI::undefined)
+    Value* var = getVariableInScope(id);
+    if (var != nullptr && *var != FFI::undefined)
         throwVMError("can not use 'let' to redefine a symbol");
 
     registerVariable(id, pop()).setConst(true);
@@ -726,8 +1473,7 @@ inline void VM_t<debug>::popJumpIfFalse()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
-    int16_t addr = static_cast<int16_t>(readNumber());
+    uint16_t addr = readNumber();
 
     if constexpr (debug)
         Ark::logger.info("POP_JUMP_IF_FALSE ({0}) PP:{1}, IP:{2}"s, addr, m_pp, m_ip);
@@ -745,8 +1491,7 @@ inline void VM_t<debug>::jump()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
-    int16_t addr = static_cast<int16_t>(readNumber());
+    uint16_t addr = readNumber();
 
     if constexpr (debug)
         Ark::logger.info("JUMP ({0}) PP:{1}, IP:{2}"s, addr, m_pp, m_ip);
@@ -779,13 +1524,17 @@ inline void VM_t<debug>::ret()
     PageAddr_t old_pp = static_cast<PageAddr_t>(m_pp);
     m_pp = m_frames.back().callerPageAddr();
     m_ip = m_frames.back().callerAddr();
-    
-    if (m_frames.back().stackSize() != 0)
+    std::size_t stack_base = m_frames.back().stackBase();
+
+    if (m_sp > stack_base)
     {
         Value return_value(pop());
+        // drop the values the function left on the stack
+        while (m_sp > stack_base)
+            m_stack[--m_sp] = Value();
         returnFromFuncCall();
-        // push value as the return value of a function to the current stack
-        push(return_value);
+        // push value as the return value of a function to the stack of the caller
+        push(std::move(return_value));
     }
     else
         returnFromFuncCall();
@@ -798,18 +1547,15 @@ inline void VM_t<debug>::call(int16_t argc_)
         Argument: number of arguments when calling the function
         Job: Call function from its symbol id located on top of the stack. Take the given number of
                 arguments from the top of stack and give them  to the function (the first argument taken
-                from the stack will be the last one of the function). The stack of the function is now composed
-                of its arguments, from the first to the last one
+                from the stack will be the last one of the function). The arguments stay in place: the
+                stack of the function starts with its arguments, the last one being on top
     */
     using namespace Ark::internal;
 
     uint16_t argc = 0;
 
     if (argc_ <= -1)
-    {
-        ++m_ip;
         argc = readNumber();
-    }
     else
         argc = argc_;
 
@@ -820,66 +1566,271 @@ inline void VM_t<debug>::call(int16_t argc_)
     if constexpr (debug)
         Ark::logger.data("function object:", function);
 
+    if (m_sp - m_fp < argc)
+        throwVMError("not enough values on the stack to call the function, expected " + Ark::Utils::toString(argc) + " arguments");
+    // the arguments stay in the stack, they are the first values of the frame of the function
+    std::size_t stack_base = m_sp - argc;
+
     switch (function.valueType())
     {
         // is it a builtin function name?
         case ValueType::CProc:
         {
-            // drop arguments from the stack
-            std::vector<Value> args(argc);
-            for (uint16_t j=0; j < argc; ++j)
-                args[j] = pop();
-            
-            // reverse arguments
-            std::reverse(args.begin(), args.end());
-            // call proc
-            push(function.proc()(args));
+            // take arguments from the stack, reusing the same vector for each call
+            // (a builtin calling the VM would get a new one)
+            std::vector<Value> args(std::move(m_proc_args));
+            args.assign(
+                std::make_move_iterator(m_stack.begin() + stack_base),
+                std::make_move_iterator(m_stack.begin() + m_sp)
+            );
+            m_sp = stack_base;
+            // call proc, append and concat taking the list from the arguments
+            if (function.proc() == &FFI::append)
+                push(FFI::appendInPlace(args));
+            else if (function.proc() == &FFI::concat)
+                push(FFI::concatInPlace(args));
+            else
+                push(function.proc()(args));
+
+            args.clear();
+            m_proc_args = std::move(args);
+
+            // (yieldToHost) pauses the VM if it can be resumed, and does nothing otherwise
+            if (m_resumable && function.proc() == &FFI::yieldToHost)
+            {
+                m_run_state = RunState::Yielded;
+                m_running = false;
+            }
             return;
         }
 
         // is it a user defined function?
         case ValueType::PageAddr:
         {
-            int old_frame = m_frames.size() - 1;
             auto new_page_pointer = function.pageAddr();
 
             // create dedicated frame
-            createNewScope();
-            m_frames.emplace_back(m_ip, m_pp, new_page_pointer);
+            createNewScope(new_page_pointer);
+            pushFrame(m_ip, m_pp, new_page_pointer, stack_base);
             // store "reference" to the function to speed the recursive functions
             registerVariable(m_last_sym_loaded, function);
 
             m_pp = new_page_pointer;
             m_ip = -1;  // because we are doing a m_ip++ right after that
-            for (std::size_t j=0; j < argc; ++j)
-                push(pop(old_frame));
             return;
         }
 
         // is it a user defined closure?
         case ValueType::Closure:
         {
-            int old_frame = m_frames.size() - 1;
             Closure& c = function.closure_ref();
             auto new_page_pointer = c.pageAddr();
 
-            // load saved scope
-            m_locals.push_back(c.scope());
-            // create dedicated frame
-            createNewScope();
-            m_frames.back().incScopeCountToDelete();
-            m_frames.emplace_back(m_ip, m_pp, new_page_pointer);
+            // load saved scope
+            pushScope(c.scope());
+            // create dedicated frame
+            createNewScope(new_page_pointer);
+            m_frames.back().incScopeCountToDelete();
+            pushFrame(m_ip, m_pp, new_page_pointer, stack_base);
+
+            m_pp = new_page_pointer;
+            m_ip = -1;  // because we are doing a m_ip++ right after that
+            return;
+        }
+
+        // is it a generator, suspended by YIELD?
+        case ValueType::Generator:
+            resumeGenerator(std::move(function), argc, stack_base);
+            return;
+
+        default:
+            throwVMError("couldn't identify function object: type index " + Ark::Utils::toString(static_cast<int>(function.valueType())));
+    }
+}
+
+template<bool debug>
+inline void VM_t<debug>::tailCall()
+{
+    /*
+        Argument: number of arguments when calling the function
+        Job: Same as CALL, used when the current function returns right after the call: its frame
+                and its scope are dropped and reused by the called function
+    */
+    using namespace Ark::internal;
+
+    // builtins don't need a frame, and the global frame can not be replaced
+    if (m_frames.size() == 1 || m_sp == m_fp ||
+        (m_stack[m_sp - 1].valueType() != ValueType::PageAddr && m_stack[m_sp - 1].valueType() != ValueType::Closure))
+    {
+        call();
+        return;
+    }
+
+    uint16_t argc = readNumber();
+
+    if constexpr (debug)
+        Ark::logger.info("TAIL_CALL ({0}) PP:{1}, IP:{2}"s, argc, m_pp, m_ip);
+
+    Value function(pop());
+    if constexpr (debug)
+        Ark::logger.data("function object:", function);
+
+    if (m_sp - m_fp < argc)
+        throwVMError("not enough values on the stack to call the function, expected " + Ark::Utils::toString(argc) + " arguments");
+
+    // move the arguments at the beginning of the current frame, and drop the other values
+    std::size_t stack_base = m_fp;
+    std::size_t first_arg = m_sp - argc;
+    for (std::size_t j=0; j < argc; ++j)
+        m_stack[stack_base + j] = std::move(m_stack[first_arg + j]);
+    for (std::size_t j=stack_base + argc; j < m_sp; ++j)
+        m_stack[j] = Value();
+    m_sp = stack_base + argc;
+
+    // drop the frame and the scopes of the current function, the called function
+    // will return directly to our caller
+    Frame current = m_frames.back();
+    m_frames.pop_back();
+    uint8_t del_counter = m_frames.back().scopeCountToDelete();
+    releaseScope();
+    while (del_counter != 0)
+    {
+        releaseScope();
+        del_counter--;
+    }
+    m_frames.back().resetScopeCountToDelete();
+
+    PageAddr_t new_page_pointer = 0;
+    if (function.valueType() == ValueType::PageAddr)
+    {
+        new_page_pointer = function.pageAddr();
+
+        createNewScope(new_page_pointer);
+        pushFrame(current.callerAddr(), current.callerPageAddr(), new_page_pointer, stack_base);
+        // store "reference" to the function to speed the recursive functions
+        registerVariable(m_last_sym_loaded, function);
+    }
+    else
+    {
+        Closure& c = function.closure_ref();
+        new_page_pointer = c.pageAddr();
+
+        // load saved scope
+        pushScope(c.scope());
+        createNewScope(new_page_pointer);
+        m_frames.back().incScopeCountToDelete();
+        pushFrame(current.callerAddr(), current.callerPageAddr(), new_page_pointer, stack_base);
+    }
+
+    m_pp = new_page_pointer;
+    m_ip = -1;  // because we are doing a m_ip++ right after that
+}
+
+template<bool debug>
+inline void VM_t<debug>::generator()
+{
+    /*
+        Argument: none
+        Job: First instruction of a generator function, run once its arguments were stored. Create a
+                Generator holding the scopes of the function, which resumes it from the next instruction,
+                and return it to the caller
+    */
+    using namespace Ark::internal;
+
+    if constexpr (debug)
+        Ark::logger.info("GENERATOR PP:{0}, IP:{1}"s, m_pp, m_ip);
+
+    // the scope captured by a closure is under the scope of the function
+    std::size_t count = 1 + m_frames[m_frames.size() - 2].scopeCountToDelete();
+    std::vector<Scope_t> scopes(m_locals.end() - count, m_locals.end());
+
+    push(Value(Generator(std::move(scopes), static_cast<PageAddr_t>(m_pp), m_ip + 1)));
+    // the scope of the function can hold the generator
+    trackScope(m_locals.back());
+    ret();
+}
+
+template<bool debug>
+inline void VM_t<debug>::yield()
+{
+    /*
+        Argument: 0 to yield a value, 1 when the generator function finished
+        Job: Suspend the generator being run, keeping its stack and the instruction to resume from,
+                then return TS to the caller. When the function finished, drop the state of the
+                generator and return nil, the generator giving nil from now on
+    */
+    using namespace Ark::internal;
+
+    uint16_t finished = readNumber();
+
+    if constexpr (debug)
+        Ark::logger.info("YIELD ({0}) PP:{1}, IP:{2}"s, finished, m_pp, m_ip);
+
+    if (m_generators.empty())
+        throwVMError("can not yield a value outside of a generator");
+
+    // keep the generator alive until we leave it
+    Value generator(std::move(m_generators.back()));
+    m_generators.pop_back();
+    Generator& g = generator.generator_ref();
+
+    Value value(finished ? FFI::nil : Value(pop()));
+    g.suspend(m_ip + 1, m_sp);
+
+    // back to the stack of the caller
+    m_pp = m_frames.back().callerPageAddr();
+    m_ip = m_frames.back().callerAddr();
+    std::swap(m_stack, g.stack());
+    m_sp = g.callerSp();
+
+    // its scopes can be reused once we leave it
+    if (finished)
+        g.finish();
+    returnFromFuncCall();
+
+    push(std::move(value));
+}
+
+template<bool debug>
+inline void VM_t<debug>::resumeGenerator(internal::Value&& generator, uint16_t argc, std::size_t stack_base)
+{
+    using namespace Ark::internal;
+
+    Generator& g = generator.generator_ref();
 
-            m_pp = new_page_pointer;
-            m_ip = -1;  // because we are doing a m_ip++ right after that
-            for (std::size_t j=0; j < argc; ++j)
-                push(pop(old_frame));
-            return;
-        }
+    if (argc > 1)
+        throwVMError("a generator takes 0 or 1 argument (the value of the yield it stopped on), got " + Ark::Utils::toString(argc));
+    if (g.state() == Generator::State::Running)
+        throwVMError("can not resume a generator which is running");
 
-        default:
-            throwVMError("couldn't identify function object: type index " + Ark::Utils::toString(static_cast<int>(function.valueType())));
+    Value sent(argc == 1 ? Value(pop()) : FFI::nil);
+    if (g.state() == Generator::State::Finished)
+    {
+        push(FFI::nil);
+        return;
+    }
+
+    // load its scopes, the one captured by a closure being dropped when returning, as for a call
+    const std::vector<Scope_t>& scopes = g.scopes();
+    for (std::size_t i=0, end=scopes.size(); i < end; ++i)
+    {
+        pushScope(scopes[i]);
+        if (i + 1 < end)
+            m_frames.back().incScopeCountToDelete();
     }
+
+    // run it on its own stack, the frame starting at its bottom
+    g.resume(stack_base);
+    std::swap(m_stack, g.stack());
+    m_sp = g.sp();
+    pushFrame(m_ip, m_pp, g.pageAddr(), 0);
+    // the value of the yield it stopped on
+    if (g.started())
+        push(std::move(sent));
+
+    m_pp = g.pageAddr();
+    m_ip = static_cast<int>(g.ip()) - 1;  // because we are doing a m_ip++ right after that
+    m_generators.push_back(std::move(generator));
 }
 
 template<bool debug>
@@ -893,19 +1844,16 @@ inline void VM_t<debug>::capture()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("CAPTURE ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("CAPTURE ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
 
     if (!m_saved_scope)
-    {
-        m_saved_scope = std::make_shared<std::vector<Value>>(
-            m_symbols.size(), internal::FFI::undefined
-        );
-    }
-    (*m_saved_scope.value())[id] = getVariableInScope(id);
+        m_saved_scope = makeRef<Scope>();
+
+    Value* var = getVariableInScope(id);
+    m_saved_scope.value()->set(id, var != nullptr ? *var : FFI::undefined);
 }
 
 template<bool debug>
@@ -917,7 +1865,6 @@ inline void VM_t<debug>::builtin()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
@@ -936,11 +1883,10 @@ inline void VM_t<debug>::mut()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("MUT ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("MUT ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
 
     registerVariable(id, pop());
 }
@@ -954,11 +1900,10 @@ inline void VM_t<debug>::del()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("DEL ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("DEL ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
     
     auto var = findNearestVariable(id);
     if (var != nullptr)
@@ -967,7 +1912,7 @@ inline void VM_t<debug>::del()
         return;
     }
 
-    throwVMError("couldn't find symbol: " + m_symbols[id]);
+    throwVMError("couldn't find symbol: " + m_program->symbols()[id]);
 }
 
 template<bool debug>
@@ -990,41 +1935,134 @@ inline void VM_t<debug>::getField()
     */
     using namespace Ark::internal;
 
-    ++m_ip;
     auto id = readNumber();
 
     if constexpr (debug)
-        Ark::logger.info("GET_FIELD ({0}) PP:{1}, IP:{2}"s, m_symbols[id], m_pp, m_ip);
+        Ark::logger.info("GET_FIELD ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
     
     auto var = pop();
     if (var.valueType() != ValueType::Closure)
-        throwVMError("variable `" + m_symbols[m_last_sym_loaded] + "' isn't a closure, can not get the field `" + m_symbols[id] + "' from it");
+        throwVMError("variable `" + m_program->symbols()[m_last_sym_loaded] + "' isn't a closure, can not get the field `" + m_program->symbols()[id] + "' from it");
     
-    auto field = (*var.closure_ref().scope())[id];
-    if (field != FFI::undefined)
+    Value* field = (*var.closure_ref().scope())[id];
+    if (field != nullptr && *field != FFI::undefined)
     {
         if constexpr (debug)
-            Ark::logger.data("Pushing closure field:", field);
+            Ark::logger.data("Pushing closure field:", *field);
         
         // check for CALL instruction
-        if (m_ip + 1 < m_pages[m_pp].size() && m_pages[m_pp][m_ip + 1] == Instruction::CALL)
+        if (static_cast<std::size_t>(m_ip) + 1 < pageSize(m_pp) && m_pages[m_pp][m_ip + 1].inst == Instruction::CALL)
         {
-            m_locals.push_back(var.closure_ref().scope());
+            pushScope(var.closure_ref().scope());
             m_frames.back().incScopeCountToDelete();
         }
 
-        push(field);
+        push(*field);
+        return;
+    }
+
+    throwVMError("couldn't find symbol in closure enviroment: " + m_program->symbols()[id]);
+}
+
+template<bool debug>
+inline void VM_t<debug>::loadLocal()
+{
+    /*
+        Argument: slot of the variable in the current scope (two bytes, big endian)
+        Job: Load a symbol declared in the current function from the current scope onto the
+                stack. If it wasn't created yet, search for it in the enclosing scopes
+    */
+    using namespace Ark::internal;
+
+    auto slot = readNumber();
+    uint16_t id = m_locals.back()->idOfSlot(slot);
+
+    if constexpr (debug)
+        Ark::logger.info("LOAD_LOCAL ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
+
+    Value& var = m_locals.back()->slot(slot);
+    if (var != FFI::undefined)
+    {
+        push(var);
+        m_last_sym_loaded = id;
+        return;
+    }
+
+    auto nearest = findNearestVariable(id);
+    if (nearest != nullptr)
+    {
+        push(*nearest);
+        m_last_sym_loaded = id;
+        return;
+    }
+
+    throwVMError("couldn't find symbol to load: " + m_program->symbols()[id]);
+}
+
+template<bool debug>
+inline void VM_t<debug>::storeLocal()
+{
+    /*
+        Argument: slot of the variable in the current scope (two bytes, big endian)
+        Job: Take the value on top of the stack and put it inside a variable declared in the
+                current function. If it wasn't created yet, search for it in the enclosing scopes
+    */
+    using namespace Ark::internal;
+
+    auto slot = readNumber();
+    uint16_t id = m_locals.back()->idOfSlot(slot);
+
+    if constexpr (debug)
+        Ark::logger.info("STORE_LOCAL ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
+
+    Value* var = &m_locals.back()->slot(slot);
+    if (*var == FFI::undefined)
+        var = findNearestVariable(id);
+
+    if (var != nullptr)
+    {
+        if (var->isConst())
+            throwVMError("can not modify a constant: " + m_program->symbols()[id]);
+        *var = pop();
+        return;
+    }
+
+    throwVMError("couldn't find symbol: " + m_program->symbols()[id]);
+}
+
+template<bool debug>
+inline void VM_t<debug>::loadGlobal()
+{
+    /*
+        Argument: symbol id (two bytes, big endian)
+        Job: Load a symbol which is only declared in the global scope onto the stack
+    */
+    using namespace Ark::internal;
+
+    auto id = readNumber();
+
+    if constexpr (debug)
+        Ark::logger.info("LOAD_GLOBAL ({0}) PP:{1}, IP:{2}"s, m_program->symbols()[id], m_pp, m_ip);
+
+    // the global scope has a slot for each symbol
+    Value& var = m_locals.front()->slot(id);
+    if (var != FFI::undefined)
+    {
+        push(var);
+        m_last_sym_loaded = id;
         return;
     }
 
-    throwVMError("couldn't find symbol in closure enviroment: " + m_symbols[id]);
+    throwVMError("couldn't find symbol to load: " + m_program->symbols()[id]);
 }
 
 template<bool debug>
-inline void VM_t<debug>::operators(uint8_t inst)
+template<uint8_t inst>
+inline void VM_t<debug>::operators()
 {
     /*
-        Handling the operator instructions
+        Handling the operator instructions. The opcode is a template parameter so
+        that the switch below is resolved at compile time, for each handler
     */
     using namespace Ark::internal;
     
@@ -1039,6 +2077,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     throw Ark::TypeError("Arguments of + should have the same type");
                 
                 push(Value(a.number() + b.number()));
+                quicken<Instruction::ADD>();
                 break;
             }
             else if (a.valueType() == ValueType::String)
@@ -1046,7 +2085,11 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 if (b.valueType() != ValueType::String)
                     throw Ark::TypeError("Arguments of + should have the same type");
                 
-                push(Value(a.string() + b.string()));
+                std::string_view left = a.string_view(), right = b.string_view();
+                std::string result;
+                result.reserve(left.size() + right.size());
+                result.append(left).append(right);
+                push(Value(std::move(result)));
                 break;
             }
             throw Ark::TypeError("Arguments of + should be Numbers or Strings");
@@ -1061,6 +2104,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 throw Ark::TypeError("Arguments of - should be Numbers");
             
             push(Value(a.number() - b.number()));
+            quicken<Instruction::SUB>();
             break;
         }
 
@@ -1073,6 +2117,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 throw Ark::TypeError("Arguments of * should be Numbers");
             
             push(Value(a.number() * b.number()));
+            quicken<Instruction::MUL>();
             break;
         }
 
@@ -1089,6 +2134,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 throw Ark::ZeroDivisionError();
             
             push(Value(a.number() / d));
+            quicken<Instruction::DIV>();
             break;
         }
 
@@ -1100,7 +2146,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 if (b.valueType() != ValueType::String)
                     throw Ark::TypeError("Arguments of > should have the same type");
                 
-                push((a.string() > b.string()) ? FFI::trueSym : FFI::falseSym);
+                push((a.string_view() > b.string_view()) ? FFI::trueSym : FFI::falseSym);
                 break;
             }
             else if (a.valueType() == ValueType::Number)
@@ -1109,6 +2155,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     throw Ark::TypeError("Arguments of > should have the same type");
                 
                 push((a.number() > b.number()) ? FFI::trueSym : FFI::falseSym);
+                quicken<Instruction::GT>();
                 break;
             }
             throw Ark::TypeError("Arguments of > should either be Strings or Numbers");
@@ -1122,7 +2169,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 if (b.valueType() != ValueType::String)
                     throw Ark::TypeError("Arguments of < should have the same type");
                 
-                push((a.string() < b.string()) ? FFI::trueSym : FFI::falseSym);
+                push((a.string_view() < b.string_view()) ? FFI::trueSym : FFI::falseSym);
                 break;
             }
             else if (a.valueType() == ValueType::Number)
@@ -1131,6 +2178,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     throw Ark::TypeError("Arguments of < should have the same type");
                 
                 push((a.number() < b.number()) ? FFI::trueSym : FFI::falseSym);
+                quicken<Instruction::LT>();
                 break;
             }
             throw Ark::TypeError("Arguments of < should either be Strings or Numbers");
@@ -1144,7 +2192,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 if (b.valueType() != ValueType::String)
                     throw Ark::TypeError("Arguments of <= should have the same type");
                 
-                push((a.string() <= b.string()) ? FFI::trueSym : FFI::falseSym);
+                push((a.string_view() <= b.string_view()) ? FFI::trueSym : FFI::falseSym);
                 break;
             }
             else if (a.valueType() == ValueType::Number)
@@ -1153,6 +2201,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     throw Ark::TypeError("Arguments of <= should have the same type");
                 
                 push((a.number() <= b.number()) ? FFI::trueSym : FFI::falseSym);
+                quicken<Instruction::LE>();
                 break;
             }
             throw Ark::TypeError("Arguments of <= should either be Strings or Numbers");
@@ -1166,7 +2215,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 if (b.valueType() != ValueType::String)
                     throw Ark::TypeError("Arguments of >= should have the same type");
                 
-                push((a.string() >= b.string()) ? FFI::trueSym : FFI::falseSym);
+                push((a.string_view() >= b.string_view()) ? FFI::trueSym : FFI::falseSym);
                 break;
             }
             else if (a.valueType() == ValueType::Number)
@@ -1175,6 +2224,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     throw Ark::TypeError("Arguments of >= should have the same type");
                 
                 push((a.number() >= b.number()) ? FFI::trueSym : FFI::falseSym);
+                quicken<Instruction::GE>();
                 break;
             }
             throw Ark::TypeError("Arguments of >= should either be Strings or Numbers");
@@ -1182,13 +2232,21 @@ inline void VM_t<debug>::operators(uint8_t inst)
 
         case Instruction::NEQ:
         {
-            push(!(pop() == pop()) ? FFI::trueSym : FFI::falseSym);
+            auto b = pop(), a = pop();
+            if (a.valueType() == ValueType::Number && b.valueType() == ValueType::Number)
+                quicken<Instruction::NEQ>();
+
+            push(!(a == b) ? FFI::trueSym : FFI::falseSym);
             break;
         }
 
         case Instruction::EQ:
         {
-            push((pop() == pop()) ? FFI::trueSym : FFI::falseSym);
+            auto b = pop(), a = pop();
+            if (a.valueType() == ValueType::Number && b.valueType() == ValueType::Number)
+                quicken<Instruction::EQ>();
+
+            push((a == b) ? FFI::trueSym : FFI::falseSym);
             break;
         }
 
@@ -1202,7 +2260,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
             }
             if (a.valueType() == ValueType::String)
             {
-                push(Value(static_cast<int>(a.string().size())));
+                push(Value(static_cast<int>(a.string_view().size())));
                 break;
             }
 
@@ -1215,7 +2273,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
             if (a.valueType() == ValueType::List)
                 push((a.const_list().size() == 0) ? FFI::trueSym : FFI::falseSym);
             else if (a.valueType() == ValueType::String)
-                push((a.string().size() == 0) ? FFI::trueSym : FFI::falseSym);
+                push(a.string_view().empty() ? FFI::trueSym : FFI::falseSym);
             else
                 throw Ark::TypeError("Argument of empty? must be a list or a String");
             
@@ -1228,7 +2286,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
             if (a.valueType() == ValueType::List)
                 push(a.const_list().size() > 0 ? a.const_list()[0] : FFI::nil);
             else if (a.valueType() == ValueType::String)
-                push(a.string().size() > 0 ? Value(std::string(1, a.string()[0])) : FFI::nil);
+                push(a.string_view().size() > 0 ? character(a.string_view()[0]) : FFI::nil);
             else
                 throw Ark::TypeError("Argument of firstOf must be a list");
 
@@ -1246,19 +2304,21 @@ inline void VM_t<debug>::operators(uint8_t inst)
                     break;
                 }
                 
-                a.list().erase(a.const_list().begin());
-                push(a);
+                // a single copy of the elements (or none with the persistent lists), instead of copying
+                // the list if it's shared then shifting them
+                push(Value(dropFirst(a.const_list())));
             }
             else if (a.valueType() == ValueType::String)
             {
-                if (a.string().size() < 2)
+                std::size_t size = a.string_view().size();
+                if (size < 2)
                 {
                     push(FFI::nil);
                     break;
                 }
 
-                a.string_ref().erase(a.string().begin());
-                push(a);
+                // shares the characters of the string instead of copying them
+                push(a.slice(1, size - 1));
             }
             else
                 throw Ark::TypeError("Argument of tailOf must be a list or a String");
@@ -1282,14 +2342,14 @@ inline void VM_t<debug>::operators(uint8_t inst)
             }
             else if (a.valueType() == ValueType::String)
             {
-                if (a.string().size() < 2)
+                std::size_t size = a.string_view().size();
+                if (size < 2)
                 {
                     push(FFI::nil);
                     break;
                 }
                 
-                a.string_ref().pop_back();
-                push(a);
+                push(a.slice(0, size - 1));
             }
             else
                 throw Ark::TypeError("Argument of headOf must be a list or a String");
@@ -1344,7 +2404,7 @@ inline void VM_t<debug>::operators(uint8_t inst)
             if (a.valueType() == ValueType::List)
                 push(a.const_list()[static_cast<long>(b.number())]);
             else if (a.valueType() == ValueType::String)
-                push(Value(std::string(1, a.string()[static_cast<long>(b.number())])));
+                push(character(a.string_view()[static_cast<long>(b.number())]));
             else
                 throw Ark::TypeError("Argument 1 of @ should be a List or a String");
             break;
@@ -1404,6 +2464,8 @@ inline void VM_t<debug>::operators(uint8_t inst)
                 }
                 case ValueType::CProc:   push(Value("CProc"));   break;
                 case ValueType::Closure: push(Value("Closure")); break;
+                case ValueType::Generator: push(Value("Generator")); break;
+                case ValueType::StringBuilder: push(Value("StringBuilder")); break;
                 default:
                     throw Ark::TypeError("unimplemented type");
             }
@@ -1418,20 +2480,471 @@ inline void VM_t<debug>::operators(uint8_t inst)
             if (field.valueType() != ValueType::String)
                 throw Ark::TypeError("Argument no 2 of hasField should be a String");
             
-            auto it = std::find(m_symbols.begin(), m_symbols.end(), field.string());
-            if (it == m_symbols.end())
+            const auto& symbols = m_program->symbols();
+            auto it = std::find(symbols.begin(), symbols.end(), field.string());
+            if (it == symbols.end())
             {
                 push(FFI::falseSym);
                 break;
             }
-            auto id = static_cast<uint16_t>(std::distance(m_symbols.begin(), it));
+            auto id = static_cast<uint16_t>(std::distance(symbols.begin(), it));
             
-            if ((*closure.closure_ref().scope_ref())[id] != FFI::undefined)
+            Value* var = (*closure.closure_ref().scope_ref())[id];
+            if (var != nullptr && *var != FFI::undefined)
                 push(FFI::trueSym);
             else
                 push(FFI::falseSym);
             
             break;
         }
+
+        case Instruction::PMAP:
+        case Instruction::PFOREACH:
+        {
+            const char* name = (inst == Instruction::PMAP) ? "pmap" : "pforEach";
+
+            auto function = pop(), list = pop();
+            if (list.valueType() != ValueType::List)
+                throw Ark::TypeError("Argument no 1 of "s + name + " should be a List");
+            if (function.valueType() != ValueType::PageAddr && function.valueType() != ValueType::Closure)
+                throw Ark::TypeError("Argument no 2 of "s + name + " should be a Function or a Closure");
+
+            std::vector<Value> results = parallelCall(function, list.const_list());
+            if constexpr (inst == Instruction::PMAP)
+                push(Value(std::move(results)));
+            else
+                push(FFI::nil);
+            break;
+        }
+    }
+}
+template<bool debug>
+template<uint8_t inst>
+inline void VM_t<debug>::numberOperators()
+{
+    /*
+        Quickened operators, the opcode being the generic operator they replace.
+        The result is written in place of the first argument. If the arguments
+        aren't both numbers, the instruction goes back to the generic operator
+    */
+    using namespace Ark::internal;
+
+    if (m_sp - m_fp >= 2)
+    {
+        Value& a = m_stack[m_sp - 2];
+        const Value& b = m_stack[m_sp - 1];
+
+        if (a.valueType() == ValueType::Number && b.valueType() == ValueType::Number)
+        {
+            double x = a.number(), y = b.number();
+
+            if constexpr (inst == Instruction::ADD)
+                a = Value(x + y);
+            else if constexpr (inst == Instruction::SUB)
+                a = Value(x - y);
+            else if constexpr (inst == Instruction::MUL)
+                a = Value(x * y);
+            else if constexpr (inst == Instruction::DIV)
+            {
+                if (y == 0)
+                    throw Ark::ZeroDivisionError();
+                a = Value(x / y);
+            }
+            else if constexpr (inst == Instruction::GT)
+                a = (x > y) ? FFI::trueSym : FFI::falseSym;
+            else if constexpr (inst == Instruction::LT)
+                a = (x < y) ? FFI::trueSym : FFI::falseSym;
+            else if constexpr (inst == Instruction::LE)
+                a = (x <= y) ? FFI::trueSym : FFI::falseSym;
+            else if constexpr (inst == Instruction::GE)
+                a = (x >= y) ? FFI::trueSym : FFI::falseSym;
+            else if constexpr (inst == Instruction::NEQ)
+                a = (x != y) ? FFI::trueSym : FFI::falseSym;
+            else if constexpr (inst == Instruction::EQ)
+                a = (x == y) ? FFI::trueSym : FFI::falseSym;
+
+            --m_sp;
+            return;
+        }
+    }
+
+    // type guard failed, deoptimize
+    rewrite(inst);
+    operators<inst>();
+}
+
+// ------------------------------------------
+//             superinstructions
+// ------------------------------------------
+
+/*
+    A superinstruction replaces the first instruction of a sequence, the other ones
+    are kept in the page: their arguments are read from there, and a jump into the
+    middle of the sequence still runs the original instructions
+*/
+
+template<bool debug>
+template<uint8_t op>
+inline void VM_t<debug>::loadLocalLoadConstOp()
+{
+    /*
+        Argument: slot of the variable, then the id of the constant in the following instruction
+        Job: LOAD_LOCAL, LOAD_CONST, then apply the operator found in the third instruction
+    */
+    loadLocal();
+    ++m_ip;
+    loadConst();
+    ++m_ip;
+    // the operator may have been quickened
+    if (m_pages[m_pp][m_ip].inst == op)
+        operators<op>();
+    else
+        numberOperators<op>();
+}
+
+template<bool debug>
+inline void VM_t<debug>::loadGlobalCall()
+{
+    /*
+        Argument: symbol id, then the number of arguments in the following instruction
+        Job: LOAD_GLOBAL then CALL
+    */
+    loadGlobal();
+    ++m_ip;
+    call();
+}
+
+template<bool debug>
+inline void VM_t<debug>::loadGlobalTailCall()
+{
+    /*
+        Argument: symbol id, then the number of arguments in the following instruction
+        Job: LOAD_GLOBAL then TAIL_CALL
+    */
+    loadGlobal();
+    ++m_ip;
+    tailCall();
+}
+
+template<bool debug>
+inline void VM_t<debug>::loadLocalCall()
+{
+    /*
+        Argument: slot of the variable, then the number of arguments in the following instruction
+        Job: LOAD_LOCAL then CALL
+    */
+    loadLocal();
+    ++m_ip;
+    call();
+}
+
+template<bool debug>
+inline void VM_t<debug>::builtinCall()
+{
+    /*
+        Argument: id of the builtin, then the number of arguments in the following instruction
+        Job: BUILTIN then CALL
+    */
+    builtin();
+    ++m_ip;
+    call();
+}
+
+// ------------------------------------------
+//                    JIT
+// ------------------------------------------
+
+template<bool debug>
+void VM_t<debug>::runNative()
+{
+    /*
+        Called after the instructions which can change of page, m_ip being the last instruction run.
+        Runs the native code of the current page, and of the pages reached from it, as long as they're
+        compiled. A page is compiled when it has been called ARK_JIT_THRESHOLD times
+    */
+    using namespace Ark::internal;
+
+    // the debug VM logs every instruction, it always interprets them
+    if constexpr (!debug)
+    {
+        while (m_running)
+        {
+            const NativeCode& native = m_native[m_pp];
+            if (native.function() == nullptr)
+            {
+                // m_ip is -1 only when a function was just called, not when returning to it
+                if (m_ip != -1 || ++m_calls_count[m_pp] != ARK_JIT_THRESHOLD || !compileNative(m_pp))
+                    return;
+            }
+
+            int ip = m_ip + 1;
+            if (static_cast<std::size_t>(ip) >= pageSize(m_pp))
+                return;
+
+            refreshNativeState();
+            native.function()(this, ip);
+
+            if (m_native_error)
+            {
+                std::exception_ptr error = m_native_error;
+                m_native_error = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+    }
+}
+
+template<bool debug>
+void VM_t<debug>::loadNativeCode(const std::vector<internal::NativeFunction>& functions)
+{
+    using namespace Ark::internal;
+
+    if (functions.size() != m_pages.size())
+        throwVMError("the native code was generated for " + Ark::Utils::toString(functions.size()) + " pages, " +
+            Ark::Utils::toString(m_pages.size()) + " were loaded");
+
+    for (std::size_t i=0, end=functions.size(); i < end; ++i)
+    {
+        if (functions[i] != nullptr)
+            m_native[i] = NativeCode(functions[i]);
+    }
+    m_features |= FeatureJIT;
+}
+
+template<bool debug>
+bool VM_t<debug>::compileNative(std::size_t page)
+{
+    /*
+        LOAD_LOCAL, STORE_LOCAL, LOAD_CONST of a number, the operators on numbers and the conditional
+        jumps are inlined, their slow paths calling the helpers after the code of the instructions.
+        The other instructions call their helper, except NOP and JUMP, which are resolved when compiling.
+        The native code goes on with the next instruction, or with the target of a conditional
+        jump, without going through the table of offsets
+    */
+    using namespace Ark::internal;
+
+    static const auto helpers = makeNativeHelpers(std::make_index_sequence<Instruction::LAST_QUICKENED + 1>());
+
+    const DecodedInst* code = m_pages[page];
+    const std::size_t size = pageSize(page);
+    NativeAssembler assembler(size, nativeLayout());
+
+    auto native_value = [](const Value& value) {
+        NativeValue native;
+        std::memcpy(&native, &value, sizeof(Value));
+        return native;
+    };
+
+    // call the helper of the instruction, then continue with the instruction it returned
+    auto call_helper = [&](std::size_t i, uint8_t inst, bool fallthrough) {
+        assembler.callHelper(helpers[inst], static_cast<int>(i), static_cast<int>(page));
+
+        if ((inst == Instruction::POP_JUMP_IF_TRUE || inst == Instruction::POP_JUMP_IF_FALSE) && code[i].arg < size)
+            assembler.jumpIfEqual(code[i].arg, code[i].arg);
+
+        // the superinstructions run the instructions following them
+        std::size_t next = i + 1;
+        if (Instruction::LOAD_LOCAL_LOAD_CONST_ADD <= inst && inst <= Instruction::LOAD_LOCAL_LOAD_CONST_EQ)
+            next = i + 3;
+        else if (Instruction::FIRST_SUPERINSTRUCTION <= inst && inst <= Instruction::LAST_SUPERINSTRUCTION)
+            next = i + 2;
+
+        if (fallthrough && next == i + 1)
+            assembler.dispatchUnless(static_cast<int>(next));
+        else
+        {
+            assembler.jumpIfEqual(static_cast<int>(next), next);
+            assembler.dispatch();
+        }
+    };
+
+    // the inlined instructions, to run with their helper when a guard fails
+    struct SlowPath
+    {
+        std::size_t label;
+        std::size_t ip;
+        uint8_t inst;
+    };
+    std::vector<SlowPath> slow_paths;
+
+    for (std::size_t i=0; i < size; ++i)
+    {
+        assembler.bind(i);
+
+        uint8_t inst = code[i].inst;
+        uint16_t arg = code[i].arg;
+        if (inst == Instruction::NOP)
+            continue;
+        else if (inst == Instruction::JUMP && arg < size)
+        {
+            assembler.jump(arg);
+            continue;
+        }
+        else if (inst >= helpers.size())
+            return false;
+
+        // the instructions fused with LOAD_LOCAL are still in the page, they are compiled on their own
+        if ((Instruction::LOAD_LOCAL_LOAD_CONST_ADD <= inst && inst <= Instruction::LOAD_LOCAL_LOAD_CONST_EQ) ||
+            inst == Instruction::LOAD_LOCAL_CALL)
+            inst = Instruction::LOAD_LOCAL;
+
+        const std::size_t slow = assembler.newLabel();
+        if (inst == Instruction::LOAD_LOCAL)
+            assembler.loadLocal(arg, slow);
+        else if (inst == Instruction::STORE_LOCAL)
+            assembler.storeLocal(arg, native_value(FFI::undefined), slow);
+        else if (inst == Instruction::LOAD_CONST && m_constants[arg].valueType() == ValueType::Number)
+            assembler.loadConst(native_value(m_constants[arg]), slow);
+        else if (Instruction::FIRST_QUICKENED <= inst && inst <= Instruction::LAST_QUICKENED)
+            // the quickened operators and NativeOperator are in the same order
+            assembler.numberOperator(static_cast<NativeOperator>(inst - Instruction::FIRST_QUICKENED),
+                                     native_value(FFI::trueSym), native_value(FFI::falseSym), slow);
+        else if ((inst == Instruction::POP_JUMP_IF_TRUE || inst == Instruction::POP_JUMP_IF_FALSE) && arg < size)
+            assembler.popJumpIf(native_value(inst == Instruction::POP_JUMP_IF_TRUE ? FFI::trueSym : FFI::falseSym), arg, slow);
+        else
+        {
+            call_helper(i, inst, true);
+            continue;
+        }
+        slow_paths.push_back({ slow, i, inst });
+    }
+    assembler.endPage();
+
+    for (const SlowPath& path : slow_paths)
+    {
+        assembler.bindLabel(path.label);
+        call_helper(path.ip, path.inst, false);
+    }
+
+    return m_native[page].load(assembler.finalize());
+}
+
+template<bool debug>
+internal::NativeLayout VM_t<debug>::nativeLayout() const
+{
+    using namespace Ark::internal;
+    using Slot = std::pair<uint16_t, Value>;
+
+    static_assert(sizeof(Value) == 16, "the native code indexes the stack with a shift");
+
+    auto offset = [this](const void* member) {
+        return static_cast<int32_t>(static_cast<const char*>(member) - reinterpret_cast<const char*>(this));
+    };
+
+    NativeLayout layout;
+    layout.ip = offset(&m_ip);
+    layout.sp = offset(&m_sp);
+    layout.fp = offset(&m_fp);
+    layout.last_sym = offset(&m_last_sym_loaded);
+    layout.stack = offset(&m_native_stack);
+    layout.stack_size = offset(&m_native_stack_size);
+    layout.locals = offset(&m_native_locals);
+    layout.slot_size = static_cast<int32_t>(sizeof(Slot));
+    layout.slot_value = static_cast<int32_t>(offsetof(Slot, second));
+    layout.number_type = static_cast<uint8_t>(ValueType::Number);
+    layout.unboxed_types = (1u << static_cast<unsigned>(ValueType::Number)) | (1u << static_cast<unsigned>(ValueType::PageAddr)) |
+        (1u << static_cast<unsigned>(ValueType::NFT)) | (1u << static_cast<unsigned>(ValueType::CProc));
+    return layout;
+}
+
+template<bool debug>
+template<uint8_t inst>
+int VM_t<debug>::nativeHelper(void* vm, int ip, int page)
+{
+    using namespace Ark::internal;
+
+    VM_t<debug>& self = *static_cast<VM_t<debug>*>(vm);
+    self.m_ip = ip;
+
+    try {
+        self.template execute<inst>();
+    } catch (...) {
+        // the native code has no unwind information, the error is rethrown by runNative
+        self.m_native_error = std::current_exception();
+        return -1;
+    }
+    self.refreshNativeState();
+
+    // only the calls, RET, HALT, GENERATOR and YIELD can leave the page or stop the VM
+    if constexpr (inst == Instruction::RET || inst == Instruction::HALT || inst == Instruction::CALL ||
+                  inst == Instruction::TAIL_CALL || inst == Instruction::LOAD_GLOBAL_CALL ||
+                  inst == Instruction::LOAD_GLOBAL_TAIL_CALL || inst == Instruction::LOAD_LOCAL_CALL ||
+                  inst == Instruction::BUILTIN_CALL || inst == Instruction::GENERATOR || inst == Instruction::YIELD)
+    {
+        if (!self.m_running || self.m_pp != static_cast<std::size_t>(page))
+            return -1;
     }
-}
\ No newline at end of file
+    return self.m_ip + 1;
+}
+
+template<bool debug>
+template<uint8_t inst>
+inline void VM_t<debug>::execute()
+{
+    using namespace Ark::internal;
+
+    if constexpr (inst == Instruction::NOP)
+        ;
+    else if constexpr (inst == Instruction::LOAD_SYMBOL)
+        loadSymbol();
+    else if constexpr (inst == Instruction::LOAD_CONST)
+        loadConst();
+    else if constexpr (inst == Instruction::POP_JUMP_IF_TRUE)
+        popJumpIfTrue();
+    else if constexpr (inst == Instruction::STORE)
+        store();
+    else if constexpr (inst == Instruction::LET)
+        let();
+    else if constexpr (inst == Instruction::POP_JUMP_IF_FALSE)
+        popJumpIfFalse();
+    else if constexpr (inst == Instruction::JUMP)
+        jump();
+    else if constexpr (inst == Instruction::RET)
+        ret();
+    else if constexpr (inst == Instruction::HALT)
+        m_running = false;
+    else if constexpr (inst == Instruction::CALL)
+        call();
+    else if constexpr (inst == Instruction::CAPTURE)
+        capture();
+    else if constexpr (inst == Instruction::BUILTIN)
+        builtin();
+    else if constexpr (inst == Instruction::MUT)
+        mut();
+    else if constexpr (inst == Instruction::DEL)
+        del();
+    else if constexpr (inst == Instruction::SAVE_ENV)
+        saveEnv();
+    else if constexpr (inst == Instruction::GET_FIELD)
+        getField();
+    else if constexpr (inst == Instruction::LOAD_LOCAL)
+        loadLocal();
+    else if constexpr (inst == Instruction::STORE_LOCAL)
+        storeLocal();
+    else if constexpr (inst == Instruction::LOAD_GLOBAL)
+        loadGlobal();
+    else if constexpr (inst == Instruction::TAIL_CALL)
+        tailCall();
+    else if constexpr (inst == Instruction::GENERATOR)
+        generator();
+    else if constexpr (inst == Instruction::YIELD)
+        yield();
+    else if constexpr (Instruction::FIRST_OPERATOR <= inst && inst <= Instruction::LAST_OPERATOR)
+        operators<inst>();
+    else if constexpr (Instruction::LOAD_LOCAL_LOAD_CONST_ADD <= inst && inst <= Instruction::LOAD_LOCAL_LOAD_CONST_EQ)
+        loadLocalLoadConstOp<inst - Instruction::LOAD_LOCAL_LOAD_CONST_ADD + Instruction::ADD>();
+    else if constexpr (inst == Instruction::LOAD_GLOBAL_CALL)
+        loadGlobalCall();
+    else if constexpr (inst == Instruction::LOAD_GLOBAL_TAIL_CALL)
+        loadGlobalTailCall();
+    else if constexpr (inst == Instruction::LOAD_LOCAL_CALL)
+        loadLocalCall();
+    else if constexpr (inst == Instruction::BUILTIN_CALL)
+        builtinCall();
+    else if constexpr (Instruction::FIRST_QUICKENED <= inst && inst <= Instruction::LAST_QUICKENED)
+        numberOperators<inst - Instruction::ADD_NUM + Instruction::ADD>();
+    else
+        throwVMError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(inst)) +
+            ", pp: " + Ark::Utils::toString(m_pp) + ", ip: " + Ark::Utils::toString(currentAddress())
+        );
+}
@@ -0,0 +1,84 @@
+#ifndef ark_vm_vmpool
+#define ark_vm_vmpool
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <cinttypes>
+
+#include <Ark/VM/Program.hpp>
+#include <Ark/VM/Value.hpp>
+
+namespace Ark
+{
+    /*
+        Calls the functions of a program from many threads. Each worker thread owns a VM, fed with
+        the program and run once to create the global variables, thus the program should only
+        declare things in its global scope. The jobs are given to the workers in turn, a worker
+        without jobs stealing the ones of the others. The VM is reset after each job: a job doesn't
+        see the global variables, nor the scopes captured by the global closures and generators,
+        modified by the previous ones
+    */
+    class VMPool
+    {
+    public:
+        // size: number of worker threads, and of VMs. The number of cores if 0. Throws the error
+        // raised by the global code of the program, if any
+        VMPool(std::shared_ptr<const Program> program, std::size_t size=0, uint16_t features=DefaultFeatures);
+        // the jobs already given are run before the workers stop
+        ~VMPool();
+
+        VMPool(const VMPool&) = delete;
+        VMPool& operator=(const VMPool&) = delete;
+
+        // call a function of the program on one of the VMs. The future holds its result, or the error
+        // it raised. The arguments and the result are deep copied when crossing threads
+        std::future<internal::Value> call(const std::string& name, std::vector<internal::Value> args={});
+
+        inline std::size_t size() const
+        {
+            return m_workers.size();
+        }
+
+    private:
+        struct Job
+        {
+            std::string name;
+            std::vector<internal::Value> args;
+            std::promise<internal::Value> result;
+        };
+
+        // jobs given to a worker: it takes them from the front, the others steal them from the back
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        std::shared_ptr<const Program> m_program;
+        uint16_t m_features;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::thread> m_threads;
+        std::atomic<std::size_t> m_next;  // worker receiving the next job
+
+        std::mutex m_mutex;  // protects m_pending and m_stop
+        std::condition_variable m_ready;
+        std::size_t m_pending;  // jobs which weren't taken by a worker yet
+        bool m_stop;
+
+        // the workers stop once all the jobs given were run
+        void stop();
+        // started is given the error of the global code, or nothing once the VM is ready for the jobs
+        void work(std::size_t index, std::promise<void> started);
+        // take a job from the given worker, or steal one from the others
+        bool take(std::size_t index, Job& job);
+    };
+}
+
+#endif
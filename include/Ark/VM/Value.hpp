@@ -2,19 +2,22 @@
 #define ark_vm_value
 
 #include <vector>
-#include <variant>
 #include <string>
+#include <string_view>
 #include <cinttypes>
 #include <iostream>
 #include <memory>
+#include <utility>
 
 #include <Ark/VM/Types.hpp>
+#include <Ark/VM/List.hpp>
 #include <Ark/VM/Closure.hpp>
+#include <Ark/VM/Generator.hpp>
 #include <Ark/Exceptions.hpp>
 
 namespace Ark::internal
 {
-    enum class ValueType
+    enum class ValueType : uint8_t
     {
         List,
         Number,
@@ -22,33 +25,103 @@ namespace Ark::internal
         PageAddr,
         NFT,
         CProc,
-        Closure
+        Closure,
+        Generator,
+        StringBuilder
     };
 
+    /*
+        Refcounted storage for the objects which can not fit inside a Value
+        (strings, lists, closures, generators and string builders). A box can be shared by
+        many values, it is copied only when a value sharing it needs to modify it, except for
+        the generators and the string builders: all the copies see their modifications
+    */
+    struct BoxBase
+    {
+        uint32_t refcount = 1;  // not atomic, see internal::Transfer to give a value to another thread
+    };
+
+    template <typename T>
+    struct Box : public BoxBase
+    {
+        T data;
+
+        template <typename... Args>
+        explicit Box(Args&&... args) :
+            data(std::forward<Args>(args)...)
+        {}
+    };
+
+    /*
+        Storage of the strings: a string owns its characters, or is a slice of a string owning them
+        (given by tailOf and headOf), sharing its characters instead of copying them. The characters
+        of a slice are copied only when a std::string is needed, to modify them or by Value::string()
+    */
+    class String
+    {
+    public:
+        explicit String(std::string&& value = std::string());
+        String(const String& other);
+        String& operator=(const String& other) = delete;
+        ~String();
+
+        inline std::string_view view() const;
+
+        // copies the characters of a slice the first time
+        const std::string& str() const;
+        std::string& str();
+
+        // the characters [offset, offset + size) of the string in box
+        static Box<String>* slice(const Box<String>* box, std::size_t offset, std::size_t size);
+
+    private:
+        mutable std::string m_data;  // the characters, if the string isn't a slice
+        mutable Box<String>* m_parent;  // the string owning the characters of a slice
+        std::size_t m_offset;
+        std::size_t m_size;
+    };
+
+    inline std::string_view String::view() const
+    {
+        if (m_parent == nullptr)
+            return m_data;
+        return std::string_view(m_parent->data.m_data.data() + m_offset, m_size);
+    }
+
     class Frame;
 
+    /*
+        A Value is 16 bytes: numbers, page addresses, NFT and C procedures are
+        stored inline, strings, lists, closures and generators are stored in a Box
+    */
     class Value
     {
     public:
         using ProcType  = Value(*)(const std::vector<Value>&);
         using Iterator = std::vector<Value>::const_iterator;
-        using Value_t = std::variant<double, std::string, PageAddr_t, NFT, ProcType, Closure, std::vector<Value>>;
 
-        Value() = default;
-        Value(Value&&) = default;
-        Value(const Value&) = default;
-        Value& operator=(const Value&) = default;
+        Value();
+        Value(const Value& other);
+        Value(Value&& other) noexcept;
+        Value& operator=(const Value& other);
+        Value& operator=(Value&& other) noexcept;
+        ~Value();
 
         Value(ValueType type);
         Value(int value);
         Value(double value);
         Value(const std::string& value);
         Value(std::string&& value);
+        Value(const char* value);
         Value(PageAddr_t value);
         Value(NFT value);
         Value(Value::ProcType value);
         Value(std::vector<Value>&& value);
+#ifdef ARK_PERSISTENT_LISTS
+        Value(List&& value);
+#endif
         Value(Closure&& value);
+        Value(Generator&& value);
 
         inline ValueType valueType() const
         {
@@ -62,42 +135,61 @@ namespace Ark::internal
 
         inline double number() const
         {
-            return std::get<double>(m_value);
+            return m_value.number;
         }
 
         inline const std::string& string() const
         {
-            return std::get<std::string>(m_value);
+            return static_cast<Box<String>*>(m_value.box)->data.str();
+        }
+
+        // the characters of a string, without copying them if it's a slice
+        inline std::string_view string_view() const
+        {
+            return static_cast<Box<String>*>(m_value.box)->data.view();
         }
 
         inline PageAddr_t pageAddr() const
         {
-            return std::get<PageAddr_t>(m_value);
+            return m_value.page_addr;
         }
 
         inline NFT nft() const
         {
-            return std::get<NFT>(m_value);
+            return m_value.nft;
         }
 
         inline const ProcType proc() const
         {
-            return std::get<Value::ProcType>(m_value);
+            return m_value.proc;
         }
 
-        inline const std::vector<Value>& const_list() const
+        inline const List& const_list() const
         {
-            return std::get<std::vector<Value>>(m_value);
+            return static_cast<Box<List>*>(m_value.box)->data;
         }
 
         inline const Closure& closure() const
         {
-            return std::get<Closure>(m_value);
+            return static_cast<Box<Closure>*>(m_value.box)->data;
         }
 
-        std::vector<Value>& list();
+        // the generator is shared by the copies of the value, it's never copied
+        inline Generator& generator_ref() const
+        {
+            return static_cast<Box<Generator>*>(m_value.box)->data;
+        }
+
+        // same for the buffer of a string builder
+        inline std::string& builder_ref() const
+        {
+            return static_cast<Box<std::string>*>(m_value.box)->data;
+        }
+
+        List& list();
         Closure& closure_ref();
         std::string& string_ref();
+        Value slice(std::size_t offset, std::size_t size) const;
         void setConst(bool value);
 
         void push_back(const Value& value);
@@ -105,20 +197,116 @@ namespace Ark::internal
 
         friend std::ostream& operator<<(std::ostream& os, const Value& V);
         friend inline bool operator==(const Value& A, const Value& B);
+        friend class CycleCollector;
 
     private:
-        Value_t m_value;
+        union Payload
+        {
+            double number;
+            PageAddr_t page_addr;
+            NFT nft;
+            ProcType proc;
+            BoxBase* box;
+        };
+
+        Payload m_value;
         ValueType m_type;
         bool m_const;
+
+        inline bool isBoxed() const
+        {
+            return m_type == ValueType::List || m_type == ValueType::String || m_type == ValueType::Closure ||
+                m_type == ValueType::Generator || m_type == ValueType::StringBuilder;
+        }
+
+        inline void retain()
+        {
+            if (isBoxed())
+                ++m_value.box->refcount;
+        }
+
+        inline void release()
+        {
+            if (isBoxed() && --m_value.box->refcount == 0)
+                destroy();
+        }
+
+        inline bool isShared() const
+        {
+            return m_value.box->refcount > 1;
+        }
+
+        void destroy();
+        void detach();
+
+        static bool boxedEqual(const Value& A, const Value& B);
     };
 
+    inline Value::Value() :
+        m_type(ValueType::NFT), m_const(false)
+    {
+        m_value.nft = NFT::Undefined;
+    }
+
+    inline Value::Value(const Value& other) :
+        m_value(other.m_value), m_type(other.m_type), m_const(other.m_const)
+    {
+        retain();
+    }
+
+    inline Value::Value(Value&& other) noexcept :
+        m_value(other.m_value), m_type(other.m_type), m_const(other.m_const)
+    {
+        // the moved-from value doesn't own the box anymore
+        other.m_type = ValueType::NFT;
+        other.m_value.nft = NFT::Undefined;
+    }
+
+    inline Value& Value::operator=(const Value& other)
+    {
+        if (this != &other)
+        {
+            Value copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    inline Value& Value::operator=(Value&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_value = other.m_value;
+            m_type = other.m_type;
+            m_const = other.m_const;
+
+            other.m_type = ValueType::NFT;
+            other.m_value.nft = NFT::Undefined;
+        }
+        return *this;
+    }
+
+    inline Value::~Value()
+    {
+        release();
+    }
+
     inline bool operator==(const Value& A, const Value& B)
     {
         // values should have the same type
         if (A.m_type != B.m_type)
             return false;
-        
-        return A.m_value == B.m_value;
+
+        switch (A.m_type)
+        {
+            case ValueType::Number:   return A.m_value.number == B.m_value.number;
+            case ValueType::PageAddr: return A.m_value.page_addr == B.m_value.page_addr;
+            case ValueType::NFT:      return A.m_value.nft == B.m_value.nft;
+            case ValueType::CProc:    return A.m_value.proc == B.m_value.proc;
+            default:
+                return A.m_value.box == B.m_value.box || Value::boxedEqual(A, B);
+        }
     }
 
     inline bool operator!=(const Value& A, const Value& B)
@@ -127,4 +315,4 @@ namespace Ark::internal
     }
 }
 
-#endif
\ No newline at end of file
+#endif
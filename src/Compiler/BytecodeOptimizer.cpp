@@ -0,0 +1,380 @@
+#include <Ark/Compiler/BytecodeOptimizer.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <Ark/Compiler/Instructions.hpp>
+#include <Ark/Utils.hpp>
+
+namespace Ark
+{
+    using namespace Ark::internal;
+
+    namespace
+    {
+        inline bool hasArgument(uint8_t inst)
+        {
+            return Instruction::FIRST_COMMAND <= inst && inst <= Instruction::LAST_COMMAND &&
+                inst != Instruction::RET && inst != Instruction::HALT && inst != Instruction::SAVE_ENV &&
+                inst != Instruction::GENERATOR;
+        }
+
+        inline bool isJump(uint8_t inst)
+        {
+            return inst == Instruction::JUMP || inst == Instruction::POP_JUMP_IF_TRUE || inst == Instruction::POP_JUMP_IF_FALSE;
+        }
+    }
+
+    BytecodeOptimizer::BytecodeOptimizer()
+    {}
+
+    void BytecodeOptimizer::feed(const bytecode_t& bytecode)
+    {
+        const bytecode_t& b = bytecode;
+        std::size_t i = 0;
+
+        m_stats = Stats();
+        m_constants.clear();
+        m_segments.clear();
+
+        auto section = [&b, &i, this] (uint8_t start, const std::string& name) {
+            if (i >= b.size() || b[i] != start)
+                throwOptimizerError("couldn't find " + name);
+            i++;
+        };
+        auto readString = [&b, &i, this] (bytecode_t& out) {
+            while (i < b.size() && b[i] != 0)
+                out.push_back(b[i++]);
+            if (i == b.size())
+                throwOptimizerError("unterminated string at address " + Ark::Utils::toString(i));
+            out.push_back(b[i++]);
+        };
+
+        // magic constant, version and timestamp
+        if (!(b.size() > 18 && b[0] == 'a' && b[1] == 'r' && b[2] == 'k' && b[3] == Instruction::NOP))
+            throwOptimizerError("invalid format: couldn't find magic constant");
+        m_header.assign(b.begin(), b.begin() + 18);
+        i = 18;
+
+        section(Instruction::SYM_TABLE_START, "symbols table");
+        m_symbols.clear();
+        for (uint16_t j=0, count=readNumber(b, i); j < count; ++j)
+            readString(m_symbols);
+        std::size_t symbols_count = std::count(m_symbols.begin(), m_symbols.end(), 0);
+
+        section(Instruction::VAL_TABLE_START, "constants table");
+        for (uint16_t j=0, count=readNumber(b, i); j < count; ++j)
+        {
+            m_constants.emplace_back();
+            if (i >= b.size())
+                throwOptimizerError("missing value " + Ark::Utils::toString(j));
+
+            uint8_t type = b[i];
+            if (type == Instruction::NUMBER_TYPE || type == Instruction::STRING_TYPE)
+                readString(m_constants.back());
+            else if (type == Instruction::FUNC_TYPE && i + 3 < b.size())
+            {
+                m_constants.back().assign(b.begin() + i, b.begin() + i + 4);
+                i += 4;
+            }
+            else
+                throwOptimizerError("unknown value type for value " + Ark::Utils::toString(j));
+        }
+
+        section(Instruction::PLUGIN_TABLE_START, "plugins table");
+        m_plugins.clear();
+        uint16_t plugins_count = readNumber(b, i);
+        for (uint16_t j=0; j < plugins_count; ++j)
+            readString(m_plugins);
+        m_plugins.insert(m_plugins.begin(), { static_cast<uint8_t>(plugins_count >> 8), static_cast<uint8_t>(plugins_count & 0xff) });
+
+        while (i < b.size() && b[i] == Instruction::CODE_SEGMENT_START)
+        {
+            i++;
+            m_segments.emplace_back();
+            Segment& segment = m_segments.back();
+
+            for (uint16_t j=0, count=readNumber(b, i); j < count; ++j)
+                segment.layout.push_back(readNumber(b, i));
+            segment.size = readNumber(b, i);
+
+            std::size_t page_end = i + segment.size;
+            if (page_end > b.size())
+                throwOptimizerError("code segment " + Ark::Utils::toString(m_segments.size() - 1) + " is truncated");
+
+            while (i < page_end)
+            {
+                uint16_t address = static_cast<uint16_t>(segment.size - (page_end - i));
+                uint8_t inst = b[i++];
+                if (!(inst == Instruction::NOP ||
+                    (Instruction::FIRST_COMMAND <= inst && inst <= Instruction::LAST_COMMAND) ||
+                    (Instruction::FIRST_OPERATOR <= inst && inst <= Instruction::LAST_OPERATOR)))
+                    throwOptimizerError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(inst)) +
+                        ", pp: " + Ark::Utils::toString(m_segments.size() - 1) + ", address: " + Ark::Utils::toString(address));
+
+                uint16_t arg = 0;
+                if (hasArgument(inst))
+                {
+                    if (i + 2 > page_end)
+                        throwOptimizerError("missing argument for instruction at address " + Ark::Utils::toString(address) +
+                            ", pp: " + Ark::Utils::toString(m_segments.size() - 1));
+                    arg = readNumber(b, i);
+                }
+                if (inst == Instruction::LOAD_CONST && arg >= m_constants.size())
+                    throwOptimizerError("invalid constant id: " + Ark::Utils::toString(arg));
+
+                segment.code.push_back({ inst, arg, address, false });
+            }
+
+            for (const auto& inst : segment.code)
+            {
+                if (isJump(inst.inst) && inst.arg != segment.size && indexOf(segment, inst.arg) == segment.code.size())
+                    throwOptimizerError("invalid jump target: " + Ark::Utils::toString(inst.arg) +
+                        ", pp: " + Ark::Utils::toString(m_segments.size() - 1));
+            }
+
+            for (uint16_t id : segment.layout)
+            {
+                if (id >= symbols_count)
+                    throwOptimizerError("invalid symbol id in the scope of pp: " + Ark::Utils::toString(m_segments.size() - 1));
+            }
+        }
+
+        m_bytecode = bytecode;
+    }
+
+    void BytecodeOptimizer::optimize()
+    {
+        for (auto& segment : m_segments)
+        {
+            threadJumps(segment);
+            removeUnreachable(segment);
+            removeNops(segment);
+            relocate(segment);
+        }
+        compactConstants();
+
+        write();
+    }
+
+    const bytecode_t& BytecodeOptimizer::bytecode() const
+    {
+        return m_bytecode;
+    }
+
+    const BytecodeOptimizer::Stats& BytecodeOptimizer::stats() const
+    {
+        return m_stats;
+    }
+
+    void BytecodeOptimizer::threadJumps(Segment& segment)
+    {
+        for (std::size_t i=0; i < segment.code.size(); ++i)
+        {
+            Record& inst = segment.code[i];
+            if (!isJump(inst.inst))
+                continue;
+
+            // follow the chains of JUMP, at most once per instruction to stop on loops
+            uint16_t target = inst.arg;
+            for (std::size_t n=0; n < segment.code.size(); ++n)
+            {
+                std::size_t j = indexOf(segment, target);
+                if (j == segment.code.size() || segment.code[j].inst != Instruction::JUMP || segment.code[j].arg == target)
+                    break;
+                target = segment.code[j].arg;
+            }
+            if (target != inst.arg)
+            {
+                inst.arg = target;
+                ++m_stats.jumps_threaded;
+            }
+
+            // a jump to the next instruction does nothing
+            if (inst.inst == Instruction::JUMP && i + 1 < segment.code.size() && segment.code[i + 1].address == inst.arg)
+            {
+                inst.inst = Instruction::NOP;
+                ++m_stats.jumps_removed;
+            }
+        }
+    }
+
+    void BytecodeOptimizer::removeUnreachable(Segment& segment)
+    {
+        if (segment.code.empty())
+            return;
+
+        std::vector<bool> reachable(segment.code.size(), false);
+        std::vector<std::size_t> to_visit = { 0 };
+
+        while (!to_visit.empty())
+        {
+            std::size_t i = to_visit.back();
+            to_visit.pop_back();
+
+            if (i >= segment.code.size() || reachable[i])
+                continue;
+            reachable[i] = true;
+
+            const Record& inst = segment.code[i];
+            if (isJump(inst.inst))
+                to_visit.push_back(indexOf(segment, inst.arg));
+
+            // the calls come back to the next instruction
+            if (inst.inst != Instruction::JUMP && inst.inst != Instruction::RET && inst.inst != Instruction::HALT)
+                to_visit.push_back(i + 1);
+        }
+
+        for (std::size_t i=0; i < segment.code.size(); ++i)
+        {
+            if (!reachable[i] && !segment.code[i].removed)
+            {
+                segment.code[i].removed = true;
+                ++m_stats.unreachable_removed;
+            }
+        }
+    }
+
+    void BytecodeOptimizer::removeNops(Segment& segment)
+    {
+        for (auto& inst : segment.code)
+        {
+            if (inst.inst == Instruction::NOP && !inst.removed)
+            {
+                inst.removed = true;
+                ++m_stats.nops_removed;
+            }
+        }
+    }
+
+    void BytecodeOptimizer::relocate(Segment& segment)
+    {
+        // new address of each old address, a removed instruction taking the
+        // address of the next instruction kept
+        std::vector<uint16_t> new_address(static_cast<std::size_t>(segment.size) + 1, 0);
+        uint16_t address = 0;
+        for (const auto& inst : segment.code)
+        {
+            new_address[inst.address] = address;
+            if (!inst.removed)
+                address += hasArgument(inst.inst) ? 3 : 1;
+        }
+        new_address[segment.size] = address;
+
+        std::vector<Record> code;
+        code.reserve(segment.code.size());
+        for (auto inst : segment.code)
+        {
+            if (inst.removed)
+                continue;
+            if (isJump(inst.inst))
+                inst.arg = new_address[inst.arg];
+            inst.address = new_address[inst.address];
+            code.push_back(inst);
+        }
+
+        segment.code = std::move(code);
+        segment.size = address;
+    }
+
+    void BytecodeOptimizer::compactConstants()
+    {
+        std::vector<bool> used(m_constants.size(), false);
+        for (const auto& segment : m_segments)
+        {
+            for (const auto& inst : segment.code)
+            {
+                if (inst.inst == Instruction::LOAD_CONST)
+                    used[inst.arg] = true;
+            }
+        }
+
+        std::vector<uint16_t> new_id(m_constants.size(), 0);
+        std::vector<bytecode_t> constants;
+        for (std::size_t i=0; i < m_constants.size(); ++i)
+        {
+            if (used[i])
+            {
+                new_id[i] = static_cast<uint16_t>(constants.size());
+                constants.push_back(std::move(m_constants[i]));
+            }
+            else
+                ++m_stats.constants_removed;
+        }
+        m_constants = std::move(constants);
+
+        for (auto& segment : m_segments)
+        {
+            for (auto& inst : segment.code)
+            {
+                if (inst.inst == Instruction::LOAD_CONST)
+                    inst.arg = new_id[inst.arg];
+            }
+        }
+    }
+
+    void BytecodeOptimizer::write()
+    {
+        m_bytecode = m_header;
+
+        m_bytecode.push_back(Instruction::SYM_TABLE_START);
+        pushNumber(static_cast<uint16_t>(std::count(m_symbols.begin(), m_symbols.end(), 0)));
+        m_bytecode.insert(m_bytecode.end(), m_symbols.begin(), m_symbols.end());
+
+        m_bytecode.push_back(Instruction::VAL_TABLE_START);
+        pushNumber(static_cast<uint16_t>(m_constants.size()));
+        for (const auto& value : m_constants)
+            m_bytecode.insert(m_bytecode.end(), value.begin(), value.end());
+
+        m_bytecode.push_back(Instruction::PLUGIN_TABLE_START);
+        m_bytecode.insert(m_bytecode.end(), m_plugins.begin(), m_plugins.end());
+
+        for (const auto& segment : m_segments)
+        {
+            m_bytecode.push_back(Instruction::CODE_SEGMENT_START);
+            pushNumber(static_cast<uint16_t>(segment.layout.size()));
+            for (uint16_t id : segment.layout)
+                pushNumber(id);
+            pushNumber(segment.size);
+
+            for (const auto& inst : segment.code)
+            {
+                m_bytecode.push_back(inst.inst);
+                if (hasArgument(inst.inst))
+                    pushNumber(inst.arg);
+            }
+        }
+    }
+
+    std::size_t BytecodeOptimizer::indexOf(const Segment& segment, uint16_t address)
+    {
+        auto it = std::lower_bound(segment.code.begin(), segment.code.end(), address,
+            [] (const Record& inst, uint16_t addr) {
+                return inst.address < addr;
+            });
+        if (it == segment.code.end() || it->address != address)
+            return segment.code.size();
+        return static_cast<std::size_t>(std::distance(segment.code.begin(), it));
+    }
+
+    void BytecodeOptimizer::pushNumber(uint16_t n)
+    {
+        m_bytecode.push_back((n & 0xff00) >> 8);
+        m_bytecode.push_back(n & 0x00ff);
+    }
+
+    uint16_t BytecodeOptimizer::readNumber(const bytecode_t& b, std::size_t& i)
+    {
+        if (i + 2 > b.size())
+            throwOptimizerError("unexpected end of bytecode");
+        uint16_t x = static_cast<uint16_t>(b[i]) << 8;
+        uint16_t y = static_cast<uint16_t>(b[i + 1]);
+        i += 2;
+        return x + y;
+    }
+
+    void BytecodeOptimizer::throwOptimizerError(const std::string& message)
+    {
+        throw std::runtime_error("BytecodeOptimizer: " + message);
+    }
+}
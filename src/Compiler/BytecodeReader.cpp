@@ -1,6 +1,7 @@
 #include <Ark/Compiler/BytecodeReader.hpp>
 
 #include <Ark/Compiler/Instructions.hpp>
+#include <Ark/Constants.hpp>
 #include <Ark/VM/FFI.hpp>
 #include <Ark/Log.hpp>
 #undef abs
@@ -10,6 +11,31 @@ namespace Ark
 {
     using namespace Ark::internal;
 
+    namespace
+    {
+        std::string instructionName(uint8_t inst)
+        {
+            static const char* commands[] = {
+                "LOAD_SYMBOL", "LOAD_CONST", "POP_JUMP_IF_TRUE", "STORE", "LET", "POP_JUMP_IF_FALSE",
+                "JUMP", "RET", "HALT", "CALL", "CAPTURE", "BUILTIN", "MUT", "DEL", "SAVE_ENV",
+                "GET_FIELD", "LOAD_LOCAL", "STORE_LOCAL", "LOAD_GLOBAL", "TAIL_CALL", "GENERATOR", "YIELD"
+            };
+            static const char* operators[] = {
+                "ADD", "SUB", "MUL", "DIV", "GT", "LT", "LE", "GE", "NEQ", "EQ", "LEN", "EMPTY",
+                "FIRSTOF", "TAILOF", "HEADOF", "ISNIL", "ASSERT", "TO_NUM", "TO_STR", "AT", "AND_",
+                "OR_", "MOD", "TYPE", "HASFIELD", "PMAP", "PFOREACH"
+            };
+
+            if (inst == Instruction::NOP)
+                return "NOP";
+            if (Instruction::FIRST_COMMAND <= inst && inst <= Instruction::LAST_COMMAND)
+                return commands[inst - Instruction::FIRST_COMMAND];
+            if (Instruction::FIRST_OPERATOR <= inst && inst <= Instruction::LAST_OPERATOR)
+                return operators[inst - Instruction::FIRST_OPERATOR];
+            return "UNKNOWN";
+        }
+    }
+
     BytecodeReader::BytecodeReader()
     {}
 
@@ -63,6 +89,20 @@ namespace Ark
         return timestamp;
     }
 
+    bool BytecodeReader::compatible()
+    {
+        bytecode_t b = bytecode();
+        std::size_t i = 0;
+
+        if (!(b.size() > 10 && b[i++] == 'a' && b[i++] == 'r' && b[i++] == 'k' && b[i++] == Instruction::NOP))
+            return false;
+
+        uint16_t major = readNumber(i); i++;
+        uint16_t minor = readNumber(i); i++;
+
+        return major == ARK_VERSION_MAJOR && minor == ARK_VERSION_MINOR;
+    }
+
     void BytecodeReader::display()
     {
         bytecode_t b = bytecode();
@@ -185,6 +225,14 @@ namespace Ark
         while (b[i] == Instruction::CODE_SEGMENT_START)
         {
             os << "Code segment (PP: " << pp << ") :\n"; i++;
+            uint16_t layout_size = readNumber(i); i++;
+            os << "Scope:";
+            for (uint16_t j=0; j < layout_size; ++j)
+            {
+                os << " " << termcolor::green << symbols[readNumber(i)] << termcolor::reset;
+                i++;
+            }
+            os << "\n";
             uint16_t size = readNumber(i); i++;
             os << "Length: " << size << "\n";
 
@@ -244,6 +292,18 @@ namespace Ark
                         os << "CALL " << termcolor::reset << "(" << readNumber(i) << ")\n";
                         i++;
                     }
+                    else if (inst == Instruction::TAIL_CALL)
+                    {
+                        os << "TAIL_CALL " << termcolor::reset << "(" << readNumber(i) << ")\n";
+                        i++;
+                    }
+                    else if (inst == Instruction::GENERATOR)
+                        os << "GENERATOR\n";
+                    else if (inst == Instruction::YIELD)
+                    {
+                        os << "YIELD " << termcolor::reset << "(" << readNumber(i) << ")\n";
+                        i++;
+                    }
                     else if (inst == Instruction::CAPTURE)
                     {
                         os << "CAPTURE " << termcolor::reset << symbols[readNumber(i)] << "\n";
@@ -271,6 +331,21 @@ namespace Ark
                         os << "GET_FIELD " << termcolor::green << symbols[readNumber(i)] << "\n";
                         i++;
                     }
+                    else if (inst == Instruction::LOAD_LOCAL)
+                    {
+                        os << "LOAD_LOCAL " << termcolor::green << symbols[readNumber(i)] << "\n";
+                        i++;
+                    }
+                    else if (inst == Instruction::STORE_LOCAL)
+                    {
+                        os << "STORE_LOCAL " << termcolor::green << symbols[readNumber(i)] << "\n";
+                        i++;
+                    }
+                    else if (inst == Instruction::LOAD_GLOBAL)
+                    {
+                        os << "LOAD_GLOBAL " << termcolor::green << symbols[readNumber(i)] << "\n";
+                        i++;
+                    }
                     else if (inst == Instruction::ADD)
                         os << "ADD\n";
                     else if (inst == Instruction::SUB)
@@ -321,6 +396,10 @@ namespace Ark
                         os << "TYPE\n";
                     else if (inst == Instruction::HASFIELD)
                         os << "HASFIELD\n";
+                    else if (inst == Instruction::PMAP)
+                        os << "PMAP\n";
+                    else if (inst == Instruction::PFOREACH)
+                        os << "PFOREACH\n";
                     else
                     {
                         os << "Unknown instruction: " << static_cast<int>(inst) << "\n";
@@ -339,6 +418,83 @@ namespace Ark
         }
     }
 
+    void BytecodeReader::countSequences(std::map<std::string, std::size_t>& pairs, std::map<std::string, std::size_t>& triples)
+    {
+        const bytecode_t& b = m_bytecode;
+        std::size_t i = 0;
+
+        if (!(b.size() > 4 && b[i++] == 'a' && b[i++] == 'r' && b[i++] == 'k' && b[i++] == Instruction::NOP))
+            throw std::runtime_error("[BytecodeReader] Invalid format");
+
+        // skip version and timestamp
+        i += 3 * 2 + 8;
+
+        auto skipString = [&b, &i] () {
+            while (b[i] != 0)
+                i++;
+            i++;
+        };
+
+        if (b[i] == Instruction::SYM_TABLE_START)
+        {
+            i++;
+            uint16_t size = readNumber(i); i++;
+            for (uint16_t j=0; j < size; ++j)
+                skipString();
+        }
+
+        if (b[i] == Instruction::VAL_TABLE_START)
+        {
+            i++;
+            uint16_t size = readNumber(i); i++;
+            for (uint16_t j=0; j < size; ++j)
+            {
+                uint8_t type = b[i]; i++;
+                if (type == Instruction::FUNC_TYPE)
+                    i += 3;  // page address and NOP
+                else
+                    skipString();
+            }
+        }
+
+        if (b[i] == Instruction::PLUGIN_TABLE_START)
+        {
+            i++;
+            uint16_t size = readNumber(i); i++;
+            for (uint16_t j=0; j < size; ++j)
+                skipString();
+        }
+
+        while (i < b.size() && b[i] == Instruction::CODE_SEGMENT_START)
+        {
+            i++;
+            uint16_t layout_size = readNumber(i); i++;
+            i += 2 * layout_size;
+            uint16_t size = readNumber(i); i++;
+
+            std::vector<std::string> names;
+            std::size_t end = i + size;
+            while (i < end)
+            {
+                uint8_t inst = b[i]; i++;
+                names.push_back(instructionName(inst));
+
+                if (Instruction::FIRST_COMMAND <= inst && inst <= Instruction::LAST_COMMAND &&
+                    inst != Instruction::RET && inst != Instruction::HALT && inst != Instruction::SAVE_ENV &&
+                    inst != Instruction::GENERATOR)
+                    i += 2;
+            }
+            i = end;
+
+            for (std::size_t j=0; j + 1 < names.size(); ++j)
+            {
+                pairs[names[j] + " " + names[j + 1]]++;
+                if (j + 2 < names.size())
+                    triples[names[j] + " " + names[j + 1] + " " + names[j + 2]]++;
+            }
+        }
+    }
+
     uint16_t BytecodeReader::readNumber(std::size_t& i)
     {
         uint16_t x = (static_cast<uint16_t>(m_bytecode[  i]) << 8),
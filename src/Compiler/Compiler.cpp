@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <chrono>
+#include <algorithm>
 
 #include <Ark/Log.hpp>
 #include <Ark/VM/FFI.hpp>
@@ -10,8 +11,8 @@ namespace Ark
 {
     using namespace Ark::internal;
 
-    Compiler::Compiler(bool debug) :
-        m_parser(debug), m_debug(debug), m_ast_ok(false)
+    Compiler::Compiler(bool debug, bool optimize) :
+        m_parser(debug), m_optimizer(debug), m_debug(debug), m_optimize(optimize), m_ast_ok(false)
     {}
 
     void Compiler::feed(const std::string& code, const std::string& filename)
@@ -84,9 +85,46 @@ namespace Ark
         m_bytecode.push_back(Instruction::SYM_TABLE_START);
             if (m_debug)
                 Ark::logger.info("Compiling");
+            if (m_optimize)
+                m_optimizer.feed(m_parser.ast());
+            const Node& ast = m_optimize ? m_optimizer.ast() : m_parser.ast();
+            // find which symbols can be addressed directly
+            {
+                std::unordered_set<std::string> globals, locals;
+                collectBindings(ast, false, globals, locals);
+                for (auto&& name : globals)
+                {
+                    if (locals.find(name) == locals.end())
+                        m_globals.insert(name);
+                }
+            }
             // gather symbols, values, and start to create code segments
             m_code_pages.emplace_back();  // create empty page
-            _compile(m_parser.ast(), 0);
+            m_page_locals.emplace_back();
+            collectLocals(ast, m_page_locals.back());
+            _compile(ast, 0);
+            // scoping is dynamic: the scope of a function, and the one captured by a closure, can not be
+            // dropped by a tail call if one of their variables can be searched for by name by the called functions
+            auto is_dynamic = [this](const std::unordered_set<std::string>& names) {
+                return std::any_of(names.begin(), names.end(), [this](const std::string& name) {
+                    return m_dynamic_symbols.count(name) != 0;
+                });
+            };
+            for (auto&& [page_id, pos] : m_tail_calls)
+            {
+                auto captures = m_page_captures.find(page_id);
+                if (is_dynamic(m_page_locals[page_id]) || (captures != m_page_captures.end() && is_dynamic(captures->second)))
+                    m_code_pages[page_id][pos] = Instruction::CALL;
+            }
+            // the scope of each page holds only the symbols declared in it
+            std::vector<std::vector<uint16_t>> layouts;
+            for (auto&& locals : m_page_locals)
+            {
+                layouts.emplace_back();
+                for (auto&& name : locals)
+                    layouts.back().push_back(static_cast<uint16_t>(addSymbol(name)));
+                std::sort(layouts.back().begin(), layouts.back().end());
+            }
         if (m_debug)
             Ark::logger.info("Adding symbols table");
         // push size
@@ -154,12 +192,18 @@ namespace Ark
             Ark::logger.info("Adding code segments");
 
         // start code segments
-        for (auto page : m_code_pages)
+        for (std::size_t page_id=0; page_id < m_code_pages.size(); ++page_id)
         {
+            const auto& page = m_code_pages[page_id];
+
             if (m_debug)
                 Ark::logger.info("-", page.size() + 1);
 
             m_bytecode.push_back(Instruction::CODE_SEGMENT_START);
+            // push the layout of its scope: number of symbols declared, then their ids
+            pushNumber(static_cast<uint16_t>(layouts[page_id].size()));
+            for (uint16_t id : layouts[page_id])
+                pushNumber(id);
             // push number of elements
             if (!page.size())
             {
@@ -178,6 +222,7 @@ namespace Ark
         if (!m_code_pages.size())
         {
             m_bytecode.push_back(Instruction::CODE_SEGMENT_START);
+            pushNumber(static_cast<uint16_t>(0));
             pushNumber(static_cast<uint16_t>(1));
             m_bytecode.push_back(Instruction::HALT);
         }
@@ -195,7 +240,12 @@ namespace Ark
         return m_bytecode;
     }
 
-    void Compiler::_compile(Ark::internal::Node x, int p)
+    const std::vector<std::size_t>& Compiler::savedInstructions() const
+    {
+        return m_optimizer.savedInstructions();
+    }
+
+    void Compiler::_compile(Ark::internal::Node x, int p, bool is_terminal)
     {
         if (m_debug)
             Ark::logger.info(x);
@@ -219,7 +269,18 @@ namespace Ark
             {
                 std::size_t i = addSymbol(name);
 
-                page(p).emplace_back(Instruction::LOAD_SYMBOL);
+                // symbols declared in the current page are read from the current scope,
+                // symbols declared only in the global scope are read from it, the others
+                // need to be searched for at runtime
+                if (m_page_locals[realPage(p)].count(name) != 0)
+                    page(p).emplace_back(Instruction::LOAD_LOCAL);
+                else if (m_globals.count(name) != 0)
+                    page(p).emplace_back(Instruction::LOAD_GLOBAL);
+                else
+                {
+                    page(p).emplace_back(Instruction::LOAD_SYMBOL);
+                    m_dynamic_symbols.insert(name);
+                }
                 pushNumber(static_cast<uint16_t>(i), &page(p));
             }
 
@@ -267,7 +328,7 @@ namespace Ark
                 // absolute address to jump to if condition is true
                 pushNumber(static_cast<uint16_t>(0x00), &page(p));
                     // else code
-                    _compile(x.list()[3], p);
+                    _compile(x.list()[3], p, is_terminal);
                     // when else is finished, jump to end
                     page(p).emplace_back(Instruction::JUMP);
                     std::size_t jump_to_end_pos = page(p).size();
@@ -276,7 +337,7 @@ namespace Ark
                 page(p)[jump_to_if_pos]     = (static_cast<uint16_t>(page(p).size()) & 0xff00) >> 8;
                 page(p)[jump_to_if_pos + 1] =  static_cast<uint16_t>(page(p).size()) & 0x00ff;
                 // if code
-                _compile(x.list()[2], p);
+                _compile(x.list()[2], p, is_terminal);
                 // set jump to end pos
                 page(p)[jump_to_end_pos]     = (static_cast<uint16_t>(page(p).size()) & 0xff00) >> 8;
                 page(p)[jump_to_end_pos + 1] =  static_cast<uint16_t>(page(p).size()) & 0x00ff;
@@ -289,7 +350,13 @@ namespace Ark
                 // put value before symbol id
                 _compile(x.list()[2], p);
 
-                page(p).emplace_back(Instruction::STORE);
+                if (m_page_locals[realPage(p)].count(name) != 0)
+                    page(p).emplace_back(Instruction::STORE_LOCAL);
+                else
+                {
+                    page(p).emplace_back(Instruction::STORE);
+                    m_dynamic_symbols.insert(name);
+                }
                 pushNumber(static_cast<uint16_t>(i), &page(p));
             }
             else if (n == Ark::internal::Keyword::Let)
@@ -329,12 +396,27 @@ namespace Ark
                 // create new page for function body
                 m_code_pages.emplace_back();
                 std::size_t page_id = m_code_pages.size() - 1;
+                // its arguments and the variables created in its body are stored in its scope,
+                // the captured variables in the scope of the closure
+                m_page_locals.emplace_back();
+                for (Ark::internal::Node::Iterator it=x.list()[1].list().begin(); it != x.list()[1].list().end(); ++it)
+                {
+                    if (it->nodeType() == NodeType::Symbol)
+                        m_page_locals.back().insert(it->string());
+                    else if (it->nodeType() == NodeType::Capture)
+                        m_page_captures[page_id].insert(it->string());
+                }
+                collectLocals(x.list()[2], m_page_locals.back());
+                bool generator = isGenerator(x.list()[2]);
+                if (generator)
+                    m_generator_pages.insert(page_id);
                 // load value on the stack
                 page(p).emplace_back(Instruction::LOAD_CONST);
                 std::size_t id = addValue(page_id);  // save page_id into the constants table as PageAddr
                 pushNumber(static_cast<uint16_t>(id), &page(p));
-                // pushing arguments from the stack into variables in the new scope
-                for (Ark::internal::Node::Iterator it=x.list()[1].list().begin(); it != x.list()[1].list().end(); ++it)
+                // pushing arguments from the stack into variables in the new scope,
+                // the last argument is on top of the stack
+                for (auto it=x.list()[1].list().rbegin(); it != x.list()[1].list().rend(); ++it)
                 {
                     if (it->nodeType() == NodeType::Symbol)
                     {
@@ -343,15 +425,28 @@ namespace Ark
                         pushNumber(static_cast<uint16_t>(var_id), &(page(page_id)));
                     }
                 }
-                // push body of the function
-                _compile(x.list()[2], page_id);
-                // return last value on the stack
-                page(page_id).emplace_back(Instruction::RET);
+                if (generator)
+                {
+                    // calling the function gives a generator, which runs the body when called
+                    page(page_id).emplace_back(Instruction::GENERATOR);
+                    // the frame of a generator can not be reused by a tail call
+                    _compile(x.list()[2], page_id);
+                    // finish the generator, it returns nil from now on
+                    page(page_id).emplace_back(Instruction::YIELD);
+                    pushNumber(static_cast<uint16_t>(1), &(page(page_id)));
+                }
+                else
+                {
+                    // push body of the function, its last expression being in tail position
+                    _compile(x.list()[2], page_id, /* is_terminal */ true);
+                    // return last value on the stack
+                    page(page_id).emplace_back(Instruction::RET);
+                }
             }
             else if (n == Ark::internal::Keyword::Begin)
             {
                 for (std::size_t i=1; i < x.list().size(); ++i)
-                    _compile(x.list()[i], p);
+                    _compile(x.list()[i], p, is_terminal && i == x.list().size() - 1);
             }
             else if (n == Ark::internal::Keyword::While)
             {
@@ -387,6 +482,8 @@ namespace Ark
                 // create new page for quoted code
                 m_code_pages.emplace_back();
                 std::size_t page_id = m_code_pages.size() - 1;
+                m_page_locals.emplace_back();
+                collectLocals(x.list()[1], m_page_locals.back());
                 _compile(x.list()[1], page_id);
                 page(page_id).emplace_back(Instruction::RET);  // return to the last frame
 
@@ -401,10 +498,28 @@ namespace Ark
                 // get id of symbol to delete
                 std::string name = x.list()[1].string();
                 std::size_t i = addSymbol(name);
+                m_dynamic_symbols.insert(name);
 
                 page(p).emplace_back(Instruction::DEL);
                 pushNumber(static_cast<uint16_t>(i), &page(p));
             }
+            else if (n == Ark::internal::Keyword::Yield)
+            {
+                if (m_generator_pages.count(realPage(p)) == 0)
+                    throw std::runtime_error("CompilerError: can not yield outside of the body of a function, "
+                        "at node `" + Utils::toString(x) + "'");
+
+                // (yield) is (yield nil)
+                if (x.list().size() > 1)
+                    _compile(x.list()[1], p);
+                else
+                {
+                    page(p).emplace_back(Instruction::BUILTIN);
+                    pushNumber(static_cast<uint16_t>(isBuiltin("nil").value()), &page(p));
+                }
+                page(p).emplace_back(Instruction::YIELD);
+                pushNumber(static_cast<uint16_t>(0), &page(p));
+            }
 
             return;
         }
@@ -412,6 +527,7 @@ namespace Ark
         // if we are here, we should have a function name
         // push arguments first, then function name, then call it
             m_temp_pages.emplace_back();
+            m_temp_pages_owner.push_back(realPage(p));
             int proc_page = -static_cast<int>(m_temp_pages.size());
             _compile(x.list()[0], proc_page);  // storing proc
             // trying to handle chained closure.field.field.field...
@@ -438,9 +554,18 @@ namespace Ark
             for (auto&& inst : m_temp_pages.back())
                 page(p).push_back(inst);
             m_temp_pages.pop_back();
+            m_temp_pages_owner.pop_back();
 
-            // call the procedure
-            page(p).push_back(Instruction::CALL);
+            // call the procedure. When the call is the last thing a function does, and the
+            // procedure isn't a closure field (which pushes the scope of the closure), the
+            // frame of the function can be reused
+            if (is_terminal && n == 1)
+            {
+                m_tail_calls.emplace_back(realPage(p), page(p).size());
+                page(p).push_back(Instruction::TAIL_CALL);
+            }
+            else
+                page(p).push_back(Instruction::CALL);
             // number of arguments
             std::size_t args_count = 0;
             for (auto it=x.list().begin() + 1; it != x.list().end(); ++it)
@@ -456,6 +581,7 @@ namespace Ark
             // retrieve operator
             auto op_inst = m_temp_pages.back()[0];
             m_temp_pages.pop_back();
+            m_temp_pages_owner.pop_back();
 
             // push arguments on current page
             std::size_t exp_count = 0;
@@ -504,6 +630,94 @@ namespace Ark
         return;
     }
 
+    void Compiler::collectBindings(const Node& x, bool in_function, std::unordered_set<std::string>& globals, std::unordered_set<std::string>& locals)
+    {
+        if (x.nodeType() != NodeType::List || x.const_list().empty())
+            return;
+
+        const Node& head = x.const_list()[0];
+        if (head.nodeType() == NodeType::Keyword)
+        {
+            Keyword n = head.keyword();
+
+            if (n == Keyword::Let || n == Keyword::Mut)
+            {
+                if (in_function)
+                    locals.insert(x.const_list()[1].string());
+                else
+                    globals.insert(x.const_list()[1].string());
+                collectBindings(x.const_list()[2], in_function, globals, locals);
+                return;
+            }
+            else if (n == Keyword::Fun)
+            {
+                // arguments and captured variables are bound in the scope of the function
+                for (auto&& arg : x.const_list()[1].const_list())
+                    locals.insert(arg.string());
+                collectBindings(x.const_list()[2], true, globals, locals);
+                return;
+            }
+            else if (n == Keyword::Quote)
+            {
+                collectBindings(x.const_list()[1], true, globals, locals);
+                return;
+            }
+        }
+
+        for (auto&& node : x.const_list())
+            collectBindings(node, in_function, globals, locals);
+    }
+
+    void Compiler::collectLocals(const Node& x, std::unordered_set<std::string>& locals)
+    {
+        if (x.nodeType() != NodeType::List || x.const_list().empty())
+            return;
+
+        const Node& head = x.const_list()[0];
+        if (head.nodeType() == NodeType::Keyword)
+        {
+            Keyword n = head.keyword();
+
+            if (n == Keyword::Let || n == Keyword::Mut)
+            {
+                locals.insert(x.const_list()[1].string());
+                collectLocals(x.const_list()[2], locals);
+                return;
+            }
+            // functions and quoted code have their own scope
+            else if (n == Keyword::Fun || n == Keyword::Quote)
+                return;
+        }
+
+        for (auto&& node : x.const_list())
+            collectLocals(node, locals);
+    }
+
+    bool Compiler::isGenerator(const Node& x)
+    {
+        if (x.nodeType() != NodeType::List || x.const_list().empty())
+            return false;
+
+        const Node& head = x.const_list()[0];
+        if (head.nodeType() == NodeType::Keyword)
+        {
+            Keyword n = head.keyword();
+
+            if (n == Keyword::Yield)
+                return true;
+            // functions and quoted code have their own page
+            else if (n == Keyword::Fun || n == Keyword::Quote)
+                return false;
+        }
+
+        for (auto&& node : x.const_list())
+        {
+            if (isGenerator(node))
+                return true;
+        }
+        return false;
+    }
+
     std::size_t Compiler::addSymbol(const std::string& sym)
     {
         // otherwise, add the symbol, and return its id in the table
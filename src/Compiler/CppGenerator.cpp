@@ -0,0 +1,255 @@
+#include <Ark/Compiler/CppGenerator.hpp>
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <Ark/Compiler/Instructions.hpp>
+#include <Ark/VM/Program.hpp>
+
+namespace Ark
+{
+    using namespace Ark::internal;
+
+    CppGenerator::CppGenerator()
+    {}
+
+    void CppGenerator::feed(const bytecode_t& bytecode, const std::string& source)
+    {
+        m_bytecode = bytecode;
+        m_source = source;
+        m_code.clear();
+        m_exported.clear();
+    }
+
+    void CppGenerator::generate(bool plugin)
+    {
+        // the VM decodes the pages and creates the superinstructions the same way when running
+        // the generated code, as long as it's created with the default features
+        Program program(m_bytecode);
+        const auto& pages = program.pages();
+
+        std::ostringstream os;
+        os << "// Generated by ark-aot from " << m_source << ", do not edit\n"
+            << "#include <Ark/Ark.hpp>\n\n"
+            << "namespace\n{\n"
+            << "    using Ark::VM;\n\n";
+
+        generateBytecode(os);
+        for (std::size_t pp=0, end=pages.size(); pp < end; ++pp)
+            generatePage(os, pages[pp], pp);
+
+        os << "    const std::vector<Ark::internal::NativeFunction> pages = {\n";
+        for (std::size_t pp=0, end=pages.size(); pp < end; ++pp)
+            os << "        &page_" << pp << ",\n";
+        os << "    };\n";
+
+        if (plugin)
+        {
+            // functions declared in the global scope: (let name (fun ...))
+            const auto& global = pages[0];
+            for (std::size_t i=0; i + 1 < global.size(); ++i)
+            {
+                if (global[i].inst == Instruction::LOAD_CONST && global[i + 1].inst == Instruction::LET &&
+                    program.constants()[global[i].arg].valueType() == ValueType::PageAddr)
+                {
+                    const std::string& name = program.symbols()[global[i + 1].arg];
+                    if (std::find(m_exported.begin(), m_exported.end(), name) == m_exported.end())
+                        m_exported.push_back(name);
+                }
+            }
+
+            generatePlugin(os);
+        }
+        else
+            generateProgram(os);
+
+        m_code = os.str();
+    }
+
+    const std::string& CppGenerator::code() const
+    {
+        return m_code;
+    }
+
+    const std::vector<std::string>& CppGenerator::exportedFunctions() const
+    {
+        return m_exported;
+    }
+
+    void CppGenerator::generateBytecode(std::ostream& os)
+    {
+        os << "    const Ark::bytecode_t bytecode = {";
+        for (std::size_t i=0, end=m_bytecode.size(); i < end; ++i)
+        {
+            if (i % 16 == 0)
+                os << "\n        ";
+            os << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(m_bytecode[i]) << std::dec << ",";
+        }
+        os << "\n    };\n\n";
+    }
+
+    void CppGenerator::generatePage(std::ostream& os, const std::vector<DecodedInst>& page, std::size_t pp)
+    {
+        /*
+            The function follows the protocol of the native code (see NativeAssembler): it starts
+            at the instruction ip, and returns when a helper asks to go back to the VM. The code
+            continues with the next instruction or with a jump target, any other instruction given
+            by a helper (recursive call, return from a call) is reached through the switch
+        */
+        const std::size_t size = page.size();
+
+        // instructions reached by a goto
+        auto next = [&page](std::size_t i) -> std::size_t {
+            uint8_t inst = page[i].inst;
+            if (Instruction::LOAD_LOCAL_LOAD_CONST_ADD <= inst && inst <= Instruction::LOAD_LOCAL_LOAD_CONST_EQ)
+                return i + 3;
+            else if (Instruction::FIRST_SUPERINSTRUCTION <= inst && inst <= Instruction::LAST_SUPERINSTRUCTION)
+                return i + 2;
+            return i + 1;
+        };
+        std::vector<bool> targets(size, false);
+        for (std::size_t i=0; i < size; ++i)
+        {
+            uint8_t inst = page[i].inst;
+            std::size_t target = size;
+            if (inst == Instruction::JUMP || inst == Instruction::POP_JUMP_IF_TRUE || inst == Instruction::POP_JUMP_IF_FALSE)
+                target = page[i].arg;
+            else if (next(i) != i + 1)
+                target = next(i);
+
+            if (target < size)
+                targets[target] = true;
+        }
+
+        os << "    // pp " << pp << "\n"
+            << "    int page_" << pp << "([[maybe_unused]] void* vm, int ip)\n"
+            << "    {\n"
+            << "        while (true)\n"
+            << "        {\n"
+            << "            switch (ip)\n"
+            << "            {\n";
+
+        for (std::size_t i=0; i < size; ++i)
+        {
+            uint8_t inst = page[i].inst;
+            uint16_t arg = page[i].arg;
+
+            os << "                case " << i << ":\n";
+            if (targets[i])
+                os << "                l" << i << ":\n";
+
+            if (inst == Instruction::NOP)
+                continue;
+            else if (inst == Instruction::JUMP)
+            {
+                if (arg < size)
+                    os << "                    goto l" << arg << ";\n";
+                else
+                    os << "                    ip = " << arg << ";\n"
+                        << "                    break;\n";
+                continue;
+            }
+
+            // the variants for numbers fall back on the generic operators
+            if (Instruction::ADD <= inst && inst <= Instruction::EQ)
+                inst = inst - Instruction::ADD + Instruction::ADD_NUM;
+
+            std::ostringstream helper;
+            helper << "VM::nativeHelper<0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(inst)
+                << std::dec << ">(vm, " << i << ", " << pp << ")";
+
+            std::size_t n = next(i);
+            if (inst == Instruction::POP_JUMP_IF_TRUE || inst == Instruction::POP_JUMP_IF_FALSE)
+            {
+                os << "                    ip = " << helper.str() << ";\n";
+                if (arg < size)
+                    os << "                    if (ip == " << arg << ")\n"
+                        << "                        goto l" << arg << ";\n";
+                os << "                    if (ip != " << n << ")\n"
+                    << "                        break;\n"
+                    << "                    [[fallthrough]];\n";
+            }
+            else if (n == i + 1)
+                os << "                    if ((ip = " << helper.str() << ") != " << n << ")\n"
+                    << "                        break;\n"
+                    << "                    [[fallthrough]];\n";
+            else
+            {
+                os << "                    ip = " << helper.str() << ";\n";
+                if (n < size)
+                    os << "                    if (ip == " << n << ")\n"
+                        << "                        goto l" << n << ";\n";
+                os << "                    break;\n";
+            }
+        }
+
+        os << "                default:\n"
+            << "                    return ip;\n"
+            << "            }\n"
+            << "        }\n"
+            << "    }\n\n";
+    }
+
+    void CppGenerator::generateProgram(std::ostream& os)
+    {
+        os << "}\n\n"
+            << "int main()\n"
+            << "{\n"
+            << "    Ark::VM vm;\n"
+            << "    vm.feed(bytecode);\n"
+            << "    vm.loadNativeCode(pages);\n"
+            << "    vm.run();\n\n"
+            << "    return 0;\n"
+            << "}\n";
+    }
+
+    void CppGenerator::generatePlugin(std::ostream& os)
+    {
+        os << "\n"
+            << "    Ark::VM& script()\n"
+            << "    {\n"
+            << "        static Ark::VM vm;\n"
+            << "        return vm;\n"
+            << "    }\n";
+
+        for (std::size_t i=0, end=m_exported.size(); i < end; ++i)
+            os << "\n"
+                << "    // " << m_exported[i] << "\n"
+                << "    Ark::internal::Value function_" << i << "(const std::vector<Ark::internal::Value>& args)\n"
+                << "    {\n"
+                << "        return script().callWithArguments(\"" << escape(m_exported[i]) << "\", args);\n"
+                << "    }\n";
+
+        os << "}\n\n"
+            << "extern \"C\" std::unordered_map<std::string, Ark::internal::Value::ProcType> getFunctionsMapping()\n"
+            << "{\n"
+            << "    // the global scope of the script is run once, to declare its functions\n"
+            << "    static bool loaded = false;\n"
+            << "    if (!loaded)\n"
+            << "    {\n"
+            << "        script().feed(bytecode);\n"
+            << "        script().loadNativeCode(pages);\n"
+            << "        script().run();\n"
+            << "        loaded = true;\n"
+            << "    }\n\n"
+            << "    std::unordered_map<std::string, Ark::internal::Value::ProcType> map;\n";
+        for (std::size_t i=0, end=m_exported.size(); i < end; ++i)
+            os << "    map[\"" << escape(m_exported[i]) << "\"] = &function_" << i << ";\n";
+        os << "\n"
+            << "    return map;\n"
+            << "}\n";
+    }
+
+    std::string CppGenerator::escape(const std::string& str)
+    {
+        std::string result;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+}
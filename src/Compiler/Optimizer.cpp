@@ -0,0 +1,409 @@
+#include <Ark/Compiler/Optimizer.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include <Ark/Utils.hpp>
+#include <Ark/VM/FFI.hpp>
+#include <Ark/Log.hpp>
+
+namespace Ark::internal
+{
+    namespace
+    {
+        inline bool isLiteral(const Node& x)
+        {
+            return x.nodeType() == NodeType::Number || x.nodeType() == NodeType::String;
+        }
+
+        // literals and the builtins true, false and nil
+        inline bool isConstant(const Node& x)
+        {
+            if (isLiteral(x))
+                return true;
+            return x.nodeType() == NodeType::Symbol &&
+                (x.string() == "true" || x.string() == "false" || x.string() == "nil");
+        }
+
+        inline bool isTrue(const Node& x)
+        {
+            return x.nodeType() == NodeType::Symbol && x.string() == "true";
+        }
+
+        inline Node boolNode(bool value)
+        {
+            Node n(NodeType::Symbol);
+            n.setString(value ? "true" : "false");
+            return n;
+        }
+
+        inline bool isOperator(const Node& x)
+        {
+            return x.nodeType() == NodeType::Symbol &&
+                std::find(FFI::operators.begin(), FFI::operators.end(), x.string()) != FFI::operators.end();
+        }
+
+        // numbers are written in the bytecode as text, with 6 significant digits: the VM
+        // computes with the value read back from it, the folding must do the same
+        inline double encoded(double value)
+        {
+            try {
+                return std::stod(Ark::Utils::toString(value));
+            } catch (const std::exception&) {}
+            return value;
+        }
+
+        // a result which can't be written without losing precision must be computed at runtime
+        inline std::optional<Node> numberNode(double value)
+        {
+            if (encoded(value) == value)
+                return Node(value);
+            return {};
+        }
+    }
+
+    Optimizer::Optimizer(bool debug) :
+        m_debug(debug)
+    {}
+
+    void Optimizer::feed(const Node& ast)
+    {
+        m_ast = ast;
+        m_declarations.clear();
+        m_modified.clear();
+        m_constants.clear();
+        m_saved.assign(1, 0);  // global page
+
+        countDeclarations(m_ast);
+        optimize(m_ast, 0, true);
+
+        if (m_debug)
+        {
+            for (std::size_t i=0; i < m_saved.size(); ++i)
+                Ark::logger.info("(Optimizer) page", i, ":", m_saved[i], "instructions saved");
+        }
+    }
+
+    const Node& Optimizer::ast() const
+    {
+        return m_ast;
+    }
+
+    const std::vector<std::size_t>& Optimizer::savedInstructions() const
+    {
+        return m_saved;
+    }
+
+    void Optimizer::countDeclarations(const Node& x)
+    {
+        if (x.nodeType() != NodeType::List || x.const_list().empty())
+            return;
+
+        const Node& head = x.const_list()[0];
+        if (head.nodeType() == NodeType::Keyword)
+        {
+            Keyword n = head.keyword();
+
+            if (n == Keyword::Let || n == Keyword::Mut)
+                m_declarations[x.const_list()[1].string()]++;
+            else if (n == Keyword::Set || n == Keyword::Del)
+                m_modified.insert(x.const_list()[1].string());
+            else if (n == Keyword::Fun)
+            {
+                for (auto&& arg : x.const_list()[1].const_list())
+                {
+                    if (arg.nodeType() == NodeType::Symbol)
+                        m_declarations[arg.string()]++;
+                }
+            }
+        }
+
+        for (auto&& child : x.const_list())
+            countDeclarations(child);
+    }
+
+    void Optimizer::optimize(Node& x, std::size_t page, bool straight)
+    {
+        if (x.nodeType() == NodeType::Symbol)
+        {
+            auto it = m_constants.find(x.string());
+            if (it != m_constants.end())
+            {
+                std::size_t line = x.line(), col = x.col();
+                x = it->second;
+                x.setPos(line, col);
+            }
+            return;
+        }
+        if (x.nodeType() != NodeType::List || x.list().empty())
+            return;
+
+        // the nodes are visited in the order used by the compiler, so that the
+        // pages are numbered the same way
+        if (x.list()[0].nodeType() == NodeType::Keyword)
+        {
+            Keyword n = x.list()[0].keyword();
+
+            if (n == Keyword::If)
+            {
+                optimize(x.list()[1], page, false);
+
+                if (auto taken = condition(x.list()[1]))
+                {
+                    std::size_t before = instructionsCount(x);
+                    // copy the branch before replacing its parent
+                    Node branch = x.list()[taken.value() ? 2 : 3];
+                    x = branch;
+                    registerSaved(page, before, instructionsCount(x));
+
+                    optimize(x, page, false);
+                }
+                else
+                {
+                    optimize(x.list()[3], page, false);
+                    optimize(x.list()[2], page, false);
+                }
+            }
+            else if (n == Keyword::Let)
+            {
+                optimize(x.list()[2], page, false);
+
+                const std::string& name = x.list()[1].string();
+                if (straight && isLiteral(x.list()[2]) && m_declarations[name] == 1 && m_modified.count(name) == 0)
+                {
+                    if (m_debug)
+                        Ark::logger.info("(Optimizer) replacing", name, "by its value");
+                    m_constants[name] = x.list()[2];
+                }
+            }
+            else if (n == Keyword::Mut || n == Keyword::Set)
+                optimize(x.list()[2], page, false);
+            else if (n == Keyword::Fun || n == Keyword::Quote)
+            {
+                std::size_t page_id = m_saved.size();
+                m_saved.push_back(0);
+                optimize(x.list()[n == Keyword::Fun ? 2 : 1], page_id, false);
+            }
+            else if (n == Keyword::Begin)
+            {
+                for (std::size_t i=1; i < x.list().size(); ++i)
+                    optimize(x.list()[i], page, straight);
+            }
+            else if (n == Keyword::While)
+            {
+                optimize(x.list()[1], page, false);
+                optimize(x.list()[2], page, false);
+            }
+            else if (n == Keyword::Yield && x.list().size() > 1)
+                optimize(x.list()[1], page, false);
+
+            return;
+        }
+
+        // function call or operator. The procedure isn't replaced if it's a symbol
+        if (x.list()[0].nodeType() == NodeType::List)
+            optimize(x.list()[0], page, false);
+        for (std::size_t i=1; i < x.list().size(); ++i)
+            optimize(x.list()[i], page, false);
+
+        if (auto folded = fold(x))
+        {
+            if (m_debug)
+                Ark::logger.info("(Optimizer) folding", x);
+
+            std::size_t before = instructionsCount(x);
+            folded->setPos(x.line(), x.col());
+            x = folded.value();
+            registerSaved(page, before, 1);
+        }
+    }
+
+    std::optional<Node> Optimizer::fold(const Node& x)
+    {
+        const Node& head = x.const_list()[0];
+        if (!isOperator(head))
+            return {};
+
+        for (auto it=x.const_list().begin() + 1; it != x.const_list().end(); ++it)
+        {
+            if (!isConstant(*it))
+                return {};
+        }
+
+        const std::string& op = head.string();
+        std::size_t argc = x.const_list().size() - 1;
+
+        if (argc == 1)
+        {
+            const Node& a = x.const_list()[1];
+
+            if (op == "len" && a.nodeType() == NodeType::String)
+                return Node(static_cast<double>(a.string().size()));
+            else if (op == "toString" && a.nodeType() == NodeType::Number)
+                return Node(Ark::Utils::toString(encoded(a.number())));
+            else if (op == "toString" && a.nodeType() == NodeType::String)
+                return a;
+            else if (op == "toNumber" && a.nodeType() == NodeType::String)
+            {
+                try {
+                    return numberNode(std::stod(a.string()));
+                } catch (const std::exception&) {}
+            }
+            return {};
+        }
+
+        // the compiler only accepts chains of these operators
+        if (argc > 2 && op != "+" && op != "-" && op != "*" && op != "/" && op != "mod" && op != "and" && op != "or")
+            return {};
+
+        if (argc >= 2)
+        {
+            std::optional<Node> result = x.const_list()[1];
+            for (std::size_t i=2; i <= argc && result; ++i)
+                result = fold(op, result.value(), x.const_list()[i]);
+            return result;
+        }
+
+        return {};
+    }
+
+    std::optional<Node> Optimizer::fold(const std::string& op, const Node& a, const Node& b)
+    {
+        // same behaviour as the VM
+        if (op == "and")
+            return boolNode(isTrue(a) && isTrue(b));
+        else if (op == "or")
+            return boolNode(isTrue(a) || isTrue(b));
+        else if (op == "=" || op == "!=")
+        {
+            bool equal = a.nodeType() == b.nodeType() &&
+                (a.nodeType() == NodeType::Number ? encoded(a.number()) == encoded(b.number()) : a == b);
+            return boolNode(op == "=" ? equal : !equal);
+        }
+
+        if (a.nodeType() == NodeType::Number && b.nodeType() == NodeType::Number)
+        {
+            double x = encoded(a.number()), y = encoded(b.number());
+
+            if (op == "+")
+                return numberNode(x + y);
+            else if (op == "-")
+                return numberNode(x - y);
+            else if (op == "*")
+                return numberNode(x * y);
+            else if (op == "/" && y != 0)
+                return numberNode(x / y);
+            else if (op == "mod")
+                return numberNode(std::fmod(x, y));
+            else if (op == "<")
+                return boolNode(x < y);
+            else if (op == ">")
+                return boolNode(x > y);
+            else if (op == "<=")
+                return boolNode(x <= y);
+            else if (op == ">=")
+                return boolNode(x >= y);
+        }
+        else if (a.nodeType() == NodeType::String && b.nodeType() == NodeType::String)
+        {
+            const std::string& x = a.string(), & y = b.string();
+
+            if (op == "+")
+                return Node(x + y);
+            else if (op == "<")
+                return boolNode(x < y);
+            else if (op == ">")
+                return boolNode(x > y);
+            else if (op == "<=")
+                return boolNode(x <= y);
+            else if (op == ">=")
+                return boolNode(x >= y);
+        }
+
+        // type errors are left to the VM
+        return {};
+    }
+
+    std::optional<bool> Optimizer::condition(const Node& x)
+    {
+        // the VM takes the first branch only if the condition is true
+        if (isConstant(x))
+            return isTrue(x);
+        return {};
+    }
+
+    std::size_t Optimizer::instructionsCount(const Node& x)
+    {
+        if (x.nodeType() != NodeType::List)
+            return 1;
+        if (x.const_list().empty())
+            return 1;  // NOP
+
+        const Nodes& l = x.const_list();
+        if (l[0].nodeType() == NodeType::Keyword)
+        {
+            switch (l[0].keyword())
+            {
+                case Keyword::If:
+                    // condition, POP_JUMP_IF_TRUE, else, JUMP, then
+                    return instructionsCount(l[1]) + 1 + instructionsCount(l[3]) + 1 + instructionsCount(l[2]);
+
+                case Keyword::Let:
+                case Keyword::Mut:
+                case Keyword::Set:
+                    return instructionsCount(l[2]) + 1;
+
+                case Keyword::Fun:
+                    // the body is in another page: the captures and a LOAD_CONST
+                    return 1 + std::count_if(l[1].const_list().begin(), l[1].const_list().end(), [](const Node& n) {
+                        return n.nodeType() == NodeType::Capture;
+                    });
+
+                case Keyword::Begin:
+                {
+                    std::size_t count = 0;
+                    for (std::size_t i=1; i < l.size(); ++i)
+                        count += instructionsCount(l[i]);
+                    return count;
+                }
+
+                case Keyword::While:
+                    return instructionsCount(l[1]) + 1 + instructionsCount(l[2]) + 1;
+
+                case Keyword::Import:
+                    return 0;
+
+                case Keyword::Quote:
+                    return 2;  // SAVE_ENV, LOAD_CONST
+
+                case Keyword::Del:
+                    return 1;
+
+                case Keyword::Yield:
+                    // the value (BUILTIN nil if none) and YIELD
+                    return (l.size() > 1 ? instructionsCount(l[1]) : 1) + 1;
+            }
+        }
+
+        std::size_t count = 0;
+        for (std::size_t i=1; i < l.size(); ++i)
+            count += instructionsCount(l[i]);
+
+        if (isOperator(l[0]))
+        {
+            // an operator is put after each argument, starting from the second one
+            std::size_t argc = std::count_if(l.begin() + 1, l.end(), [](const Node& n) {
+                return n.nodeType() != NodeType::GetField && n.nodeType() != NodeType::Capture;
+            });
+            return count + (argc > 1 ? argc - 1 : argc);
+        }
+        // procedure, arguments, CALL
+        return instructionsCount(l[0]) + count + 1;
+    }
+
+    void Optimizer::registerSaved(std::size_t page, std::size_t before, std::size_t after)
+    {
+        if (before > after)
+            m_saved[page] += before - after;
+    }
+}
@@ -171,6 +171,7 @@ namespace Ark::internal
                 case Keyword::Import: os << "Import"; break;
                 case Keyword::Quote:  os << "Quote";  break;
                 case Keyword::Del:    os << "Del";    break;
+                case Keyword::Yield:  os << "Yield";  break;
             }
             break;
 
@@ -234,6 +234,12 @@ namespace Ark
                         else
                             throwParseError("invalid token: del can only be applied to identifers", tokens.front());
                     }
+                    else if (token.token == "yield")
+                    {
+                        // the value is optional, (yield) yielding nil
+                        if (tokens.front().token != ")")
+                            block.push_back(parse(tokens));
+                    }
                 }
                 else if (token.type == TokenType::Identifier || token.type == TokenType::Operator ||
                         (token.type == TokenType::Capture && authorize_capture) ||
@@ -310,6 +316,7 @@ namespace Ark
             else if (token.token == "import") kw = Keyword::Import;
             else if (token.token == "quote")  kw = Keyword::Quote;
             else if (token.token == "del")    kw = Keyword::Del;
+            else if (token.token == "yield")  kw = Keyword::Yield;
             if (kw)
             {
                 auto n = Node(kw.value());
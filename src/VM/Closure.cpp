@@ -1,16 +1,17 @@
 #include <Ark/VM/Closure.hpp>
 
 #include <Ark/VM/Value.hpp>
+#include <Ark/VM/Scope.hpp>
 
 namespace Ark::internal
 {
     Closure::Closure() :
-        m_scope(nullptr),
+        m_scope(),
         m_page_addr(0)
     {}
 
     Closure::Closure(Scope_t&& scope_ptr, PageAddr_t pa) :
-        m_scope(scope_ptr),
+        m_scope(std::move(scope_ptr)),
         m_page_addr(pa)
     {}
 
@@ -0,0 +1,172 @@
+#include <Ark/VM/CycleCollector.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+
+namespace Ark::internal
+{
+    namespace
+    {
+        struct Node
+        {
+            Scope_t scope;       // for a scope, kept alive until the cycles are broken
+            const Value* value;  // for a box, a value holding it
+            std::size_t internal;  // references coming from the graph, and from the node itself
+            bool alive;
+        };
+    }
+
+    CycleCollector::CycleCollector() :
+        m_threshold(ARK_CYCLES_THRESHOLD)
+    {}
+
+    std::size_t CycleCollector::collect()
+    {
+        std::size_t freed = 0;
+
+        {
+            std::vector<Node> nodes;
+            std::unordered_map<const void*, std::size_t> index;  // scope or box -> node
+
+            auto add_scope = [&](const Scope_t& scope) -> std::size_t {
+                auto [it, inserted] = index.try_emplace(scope.get(), nodes.size());
+                if (inserted)
+                    nodes.push_back(Node { scope, nullptr, 1, false });
+                return it->second;
+            };
+
+            // find the graph reachable from the tracked scopes, counting the references between its objects
+            for (const auto& candidate : m_candidates)
+            {
+                if (Scope_t scope = candidate.lock())
+                    add_scope(scope);
+            }
+
+            auto count_value = [&](const Value& value) {
+                if (const BoxBase* box = boxOf(value))
+                {
+                    auto [it, inserted] = index.try_emplace(box, nodes.size());
+                    if (inserted)
+                        nodes.push_back(Node { Scope_t(), &value, 0, false });
+                    ++nodes[it->second].internal;
+                }
+            };
+            auto count_scope = [&](const Scope_t& scope) {
+                ++nodes[add_scope(scope)].internal;
+            };
+            for (std::size_t i=0; i < nodes.size(); ++i)
+                forEachChild(nodes[i].scope.get(), nodes[i].value, count_value, count_scope);
+
+            // the objects referenced from outside of the graph are alive, as the objects they reach
+            std::vector<std::size_t> alive;
+            for (std::size_t i=0, end=nodes.size(); i < end; ++i)
+            {
+                std::size_t refcount = nodes[i].scope ?
+                    static_cast<std::size_t>(nodes[i].scope.use_count()) :
+                    boxOf(*nodes[i].value)->refcount;
+
+                if (refcount > nodes[i].internal)
+                {
+                    nodes[i].alive = true;
+                    alive.push_back(i);
+                }
+            }
+
+            auto mark = [&](const void* object) {
+                Node& node = nodes[index[object]];
+                if (!node.alive)
+                {
+                    node.alive = true;
+                    alive.push_back(&node - nodes.data());
+                }
+            };
+            while (!alive.empty())
+            {
+                std::size_t i = alive.back();
+                alive.pop_back();
+                forEachChild(nodes[i].scope.get(), nodes[i].value,
+                    [&](const Value& value) {
+                        if (const BoxBase* box = boxOf(value))
+                            mark(box);
+                    },
+                    [&](const Scope_t& scope) {
+                        mark(scope.get());
+                    });
+            }
+
+            // break the cycles: the garbage generators drop their scopes and their stack, the garbage
+            // scopes their variables. The generators are kept alive until all of them were stopped
+            std::vector<Value> generators;
+            for (const Node& node : nodes)
+            {
+                if (!node.alive && node.value != nullptr && node.value->valueType() == ValueType::Generator)
+                    generators.push_back(*node.value);
+            }
+            for (Value& generator : generators)
+                generator.generator_ref().finish();
+
+            for (Node& node : nodes)
+            {
+                if (!node.alive && node.scope)
+                {
+                    node.scope->clear();
+                    ++freed;
+                }
+            }
+        }
+
+        // forget the scopes which were freed, and wait for the number of tracked scopes to double
+        m_candidates.erase(
+            std::remove_if(m_candidates.begin(), m_candidates.end(), [](const WeakRef<Scope>& candidate) {
+                return candidate.expired();
+            }),
+            m_candidates.end());
+        m_threshold = std::max<std::size_t>(ARK_CYCLES_THRESHOLD, 2 * m_candidates.size());
+
+        return freed;
+    }
+
+    template <typename OnValue, typename OnScope>
+    void CycleCollector::forEachChild(Scope* scope, const Value* value, OnValue&& on_value, OnScope&& on_scope)
+    {
+        if (scope != nullptr)
+        {
+            for (std::size_t i=0, end=scope->size(); i < end; ++i)
+                on_value(scope->slot(i));
+            return;
+        }
+
+        switch (value->valueType())
+        {
+            case ValueType::List:
+                for (const Value& element : value->const_list())
+                    on_value(element);
+                break;
+
+            case ValueType::Closure:
+                on_scope(value->closure().scope());
+                break;
+
+            case ValueType::Generator:
+            {
+                Generator& generator = value->generator_ref();
+                for (const Scope_t& generator_scope : generator.scopes())
+                    on_scope(generator_scope);
+                for (const Value& element : generator.stack())
+                    on_value(element);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    const BoxBase* CycleCollector::boxOf(const Value& value)
+    {
+        // the strings and the string builders don't reference other objects
+        if (!value.isBoxed() || value.m_type == ValueType::String || value.m_type == ValueType::StringBuilder)
+            return nullptr;
+        return value.m_value.box;
+    }
+}
@@ -6,6 +6,7 @@
 #undef abs
 #include <cmath>
 #include <chrono>
+#include <cstdio>
 
 #define FFI_Function(name) Value name(const std::vector<Value>& n)
 
@@ -29,7 +30,12 @@ namespace Ark::internal::FFI
         { "writeFile", Value(&writeFile) },
         { "readFile", Value(&readFile) },
         { "fileExists?", Value(&fileExists) },
-        { "time", Value(&timeSinceEpoch) }
+        { "time", Value(&timeSinceEpoch) },
+        { "yieldToHost", Value(&yieldToHost) },
+        { "stringBuilder", Value(&stringBuilder) },
+        { "builderAppend", Value(&builderAppend) },
+        { "builderAppendNumber", Value(&builderAppendNumber) },
+        { "builderFinish", Value(&builderFinish) }
     };
 
     extern const std::vector<std::string> operators = {
@@ -40,34 +46,55 @@ namespace Ark::internal::FFI
         "toNumber", "toString",
         "@", "and", "or", "mod",
         "type", "hasField",
+        "pmap", "pforEach",
     };
 
     // ------------------------------
 
     FFI_Function(append)
+    {
+        std::vector<Value> args(n);
+        return appendInPlace(args);
+    }
+
+    FFI_Function(concat)
+    {
+        std::vector<Value> args(n);
+        return concatInPlace(args);
+    }
+
+    Value appendInPlace(std::vector<Value>& n)
     {
         if (n[0].valueType() != ValueType::List)
             throw Ark::TypeError("First argument of append must be a list");
-        
+
+        // the list is taken from the arguments so that it's extended in place when nothing else references it
         Value r(std::move(n[0]));
         for (Value::Iterator it=n.begin()+1; it != n.end(); ++it)
             r.push_back(*it);
         return r;
     }
 
-    FFI_Function(concat)
+    Value concatInPlace(std::vector<Value>& n)
     {
         if (n[0].valueType() != ValueType::List)
             throw Ark::TypeError("First argument of concat should be a list");
         
-        Value r(std::move(n[0]));
         for (Value::Iterator it=n.begin()+1; it != n.end(); ++it)
         {
             if (it->valueType() != ValueType::List)
                 throw Ark::TypeError("Arguments of concat must be lists");
+        }
 
-            for (Value::Iterator it2=it->const_list().begin(); it2 != it->const_list().end(); ++it2)
-                r.push_back(*it2);
+        // as for append, the first list is extended in place if it isn't shared
+        Value r(std::move(n[0]));
+        for (Value::Iterator it=n.begin()+1; it != n.end(); ++it)
+        {
+            // a copy of the list, in case it's concatenated to itself
+            if (it->const_list().empty())
+                continue;
+            Value other(*it);
+            appendAll(r.list(), other.const_list());
         }
         return r;
     }
@@ -182,4 +209,72 @@ namespace Ark::internal::FFI
         const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
         return Value(static_cast<double>(milliseconds.count()) / 1000);
     }
+
+    FFI_Function(yieldToHost)
+    {
+        // the VM recognizes this function when calling it, nothing to do here
+        (void) n;
+        return nil;
+    }
+
+    FFI_Function(stringBuilder)
+    {
+        if (n.size() > 1)
+            throw std::runtime_error("stringBuilder can take only 0 or 1 argument, the initial content (String)");
+
+        Value builder(ValueType::StringBuilder);
+        if (n.size() == 1)
+        {
+            if (n[0].valueType() != ValueType::String)
+                throw Ark::TypeError("Argument of stringBuilder must be of type String");
+            builder.builder_ref().append(n[0].string_view());
+        }
+        return builder;
+    }
+
+    FFI_Function(builderAppend)
+    {
+        if (n.empty() || n[0].valueType() != ValueType::StringBuilder)
+            throw Ark::TypeError("First argument of builderAppend must be a StringBuilder");
+
+        // the buffer grows geometrically, the content isn't copied at each append
+        std::string& buffer = n[0].builder_ref();
+        for (Value::Iterator it=n.begin()+1; it != n.end(); ++it)
+        {
+            if (it->valueType() != ValueType::String)
+                throw Ark::TypeError("Arguments of builderAppend must be Strings");
+            buffer.append(it->string_view());
+        }
+        return n[0];
+    }
+
+    FFI_Function(builderAppendNumber)
+    {
+        if (n.empty() || n[0].valueType() != ValueType::StringBuilder)
+            throw Ark::TypeError("First argument of builderAppendNumber must be a StringBuilder");
+
+        std::string& buffer = n[0].builder_ref();
+        for (Value::Iterator it=n.begin()+1; it != n.end(); ++it)
+        {
+            if (it->valueType() != ValueType::Number)
+                throw Ark::TypeError("Arguments of builderAppendNumber must be Numbers");
+
+            // same format as toString (std::ostream's default, 6 significant digits), without a stream
+            char digits[32];
+            int size = std::snprintf(digits, sizeof(digits), "%g", it->number());
+            buffer.append(digits, static_cast<std::size_t>(size));
+        }
+        return n[0];
+    }
+
+    FFI_Function(builderFinish)
+    {
+        if (n.size() != 1 || n[0].valueType() != ValueType::StringBuilder)
+            throw Ark::TypeError("Argument of builderFinish must be a StringBuilder");
+
+        // the buffer becomes the string, the builder is left empty to be reused
+        Value result(std::move(n[0].builder_ref()));
+        n[0].builder_ref().clear();
+        return result;
+    }
 }
@@ -0,0 +1,40 @@
+#include <Ark/VM/Generator.hpp>
+
+#include <Ark/VM/Value.hpp>
+#include <Ark/VM/Scope.hpp>
+
+namespace Ark::internal
+{
+    Generator::Generator(std::vector<Scope_t>&& scopes, PageAddr_t pa, std::size_t ip) :
+        m_scopes(std::move(scopes)),
+        m_stack(16),  // grows like the stack of the VM
+        m_sp(0),
+        m_caller_sp(0),
+        m_page_addr(pa),
+        m_ip(ip),
+        m_state(State::Suspended),
+        m_started(false)
+    {}
+
+    void Generator::resume(std::size_t caller_sp)
+    {
+        m_caller_sp = caller_sp;
+        m_state = State::Running;
+    }
+
+    void Generator::suspend(std::size_t ip, std::size_t sp)
+    {
+        m_ip = ip;
+        m_sp = sp;
+        m_state = State::Suspended;
+        m_started = true;
+    }
+
+    void Generator::finish()
+    {
+        m_scopes.clear();
+        std::vector<Value>().swap(m_stack);
+        m_sp = 0;
+        m_state = State::Finished;
+    }
+}
@@ -0,0 +1,450 @@
+#include <Ark/VM/JIT.hpp>
+
+#include <cstring>
+
+#ifdef ARK_JIT_AVAILABLE
+    #include <sys/mman.h>
+#endif
+
+namespace Ark::internal
+{
+    NativeCode::NativeCode() :
+        m_memory(nullptr)
+        , m_size(0)
+        , m_function(nullptr)
+    {}
+
+    NativeCode::NativeCode(NativeFunction function) :
+        m_memory(nullptr)
+        , m_size(0)
+        , m_function(function)
+    {}
+
+    NativeCode::~NativeCode()
+    {
+        unload();
+    }
+
+    NativeCode::NativeCode(NativeCode&& other) :
+        m_memory(std::exchange(other.m_memory, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+        , m_function(std::exchange(other.m_function, nullptr))
+    {}
+
+    NativeCode& NativeCode::operator=(NativeCode&& other)
+    {
+        if (this != &other)
+        {
+            unload();
+            m_memory = std::exchange(other.m_memory, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_function = std::exchange(other.m_function, nullptr);
+        }
+        return *this;
+    }
+
+    bool NativeCode::load(const std::vector<uint8_t>& code)
+    {
+        unload();
+
+#ifdef ARK_JIT_AVAILABLE
+        void* memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return false;
+
+        std::memcpy(memory, code.data(), code.size());
+        // never writable and executable at the same time
+        if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory, code.size());
+            return false;
+        }
+
+        m_memory = memory;
+        m_size = code.size();
+        m_function = reinterpret_cast<NativeFunction>(m_memory);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void NativeCode::unload()
+    {
+#ifdef ARK_JIT_AVAILABLE
+        if (m_memory != nullptr)
+            munmap(m_memory, m_size);
+#endif
+        m_memory = nullptr;
+        m_size = 0;
+        m_function = nullptr;
+    }
+
+    // registers, as encoded in the instructions
+    namespace
+    {
+        constexpr uint8_t rax = 0, rcx = 1, rdx = 2, rbx = 3, rsi = 6;
+    }
+
+    NativeAssembler::NativeAssembler(std::size_t instructions, const NativeLayout& layout) :
+        m_layout(layout)
+        , m_instructions(instructions)
+        , m_labels(instructions + 1, 0)
+        , m_bound(0)
+    {
+        // entry: save rbx, which holds the VM, and dispatch on the index of the first instruction
+        emit({ 0x53 });                    // push rbx
+        emit({ 0x48, 0x89, 0xfb });        // mov rbx, rdi
+        emit({ 0x89, 0xf0 });              // mov eax, esi
+
+        m_dispatch = m_code.size();
+        emit({ 0x3d });                    // cmp eax, instructions
+        emit32(static_cast<uint32_t>(instructions));
+        emit({ 0x0f, 0x87 });              // ja exit (-1 is above too)
+        emitRel32(ExitLabel);
+        emit({ 0x48, 0x63, 0xc0 });        // movsxd rax, eax
+        emit({ 0x48, 0x8d, 0x0d });        // lea rcx, [rip + start of the code]
+        emit32(static_cast<uint32_t>(-static_cast<int32_t>(m_code.size() + 4)));
+        emit({ 0x48, 0x63, 0x84, 0x81 });  // movsxd rax, dword [rcx + rax * 4 + table]
+        m_table_disp = m_code.size();
+        emit32(0);
+        emit({ 0x48, 0x01, 0xc8 });        // add rax, rcx
+        emit({ 0xff, 0xe0 });              // jmp rax
+
+        m_exit = m_code.size();
+        emit({ 0x5b });                    // pop rbx
+        emit({ 0xc3 });                    // ret
+    }
+
+    void NativeAssembler::bind(std::size_t ip)
+    {
+        // the instructions without code (NOP) are bound to the code of the following one
+        while (m_bound <= ip && m_bound <= m_instructions)
+            m_labels[m_bound++] = m_code.size();
+    }
+
+    void NativeAssembler::endPage()
+    {
+        bind(m_instructions);
+        // m_ip is the last instruction run, the VM raises the error of the instruction pointer going too far
+        emit({ 0xc7 });                    // mov dword [rbx + ip], instructions - 1
+        memory(0, rbx, m_layout.ip);
+        emit32(static_cast<uint32_t>(m_instructions - 1));
+        jump(ExitLabel);
+    }
+
+    std::size_t NativeAssembler::newLabel()
+    {
+        m_labels.push_back(0);
+        return m_labels.size() - 1;
+    }
+
+    void NativeAssembler::bindLabel(std::size_t label)
+    {
+        m_labels[label] = m_code.size();
+    }
+
+    void NativeAssembler::loadLocal(uint16_t slot, std::size_t slow)
+    {
+        const int32_t value = slot * m_layout.slot_size + m_layout.slot_value;
+
+        emit({ 0x48, 0x8b });              // mov rsi, [rbx + locals]
+        memory(rsi, rbx, m_layout.locals);
+        emit({ 0x80 });                    // cmp byte [rsi + value + 8], number
+        memory(7, rsi, value + 8);
+        emit({ m_layout.number_type });
+        jumpIf(0x85, slow);                // jne slow
+        emit({ 0x48, 0x8b });              // mov rax, [rbx + sp]
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x48, 0x3b });              // cmp rax, [rbx + stack_size]
+        memory(rax, rbx, m_layout.stack_size);
+        jumpIf(0x83, slow);                // jae slow, the stack must grow
+        stackAddress();
+        guardNotBoxed(0, slow);
+
+        emit({ 0x0f, 0x10 });              // movups xmm0, [rsi + value]
+        memory(0, rsi, value);
+        emit({ 0x0f, 0x11, 0x01 });        // movups [rcx], xmm0
+        emit({ 0x48, 0xff, 0xc0 });        // inc rax
+        emit({ 0x48, 0x89 });              // mov [rbx + sp], rax
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x0f, 0xb7 });              // movzx edx, word [rsi + id of the slot]
+        memory(rdx, rsi, slot * m_layout.slot_size);
+        emit({ 0x66, 0x89 });              // mov [rbx + last_sym], dx
+        memory(rdx, rbx, m_layout.last_sym);
+    }
+
+    void NativeAssembler::storeLocal(uint16_t slot, const NativeValue& undefined, std::size_t slow)
+    {
+        const int32_t value = slot * m_layout.slot_size + m_layout.slot_value;
+
+        emit({ 0x48, 0x8b });              // mov rsi, [rbx + locals]
+        memory(rsi, rbx, m_layout.locals);
+        emit({ 0x66, 0x81 });              // cmp word [rsi + value + 8], number: a number which isn't const
+        memory(7, rsi, value + 8);
+        emit({ m_layout.number_type, 0x00 });
+        jumpIf(0x85, slow);                // jne slow
+        emit({ 0x48, 0x8b });              // mov rax, [rbx + sp]
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x48, 0x3b });              // cmp rax, [rbx + fp]
+        memory(rax, rbx, m_layout.fp);
+        jumpIf(0x86, slow);                // jbe slow, nothing to pop in this frame
+        emit({ 0x48, 0xff, 0xc8 });        // dec rax
+        stackAddress();
+
+        // the value is moved, the one left in the stack doesn't own its box anymore
+        emit({ 0x0f, 0x10, 0x01 });        // movups xmm0, [rcx]
+        emit({ 0x0f, 0x11 });              // movups [rsi + value], xmm0
+        memory(0, rsi, value);
+        storeValue(undefined, 0);
+        emit({ 0x48, 0x89 });              // mov [rbx + sp], rax
+        memory(rax, rbx, m_layout.sp);
+    }
+
+    void NativeAssembler::loadConst(const NativeValue& value, std::size_t slow)
+    {
+        emit({ 0x48, 0x8b });              // mov rax, [rbx + sp]
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x48, 0x3b });              // cmp rax, [rbx + stack_size]
+        memory(rax, rbx, m_layout.stack_size);
+        jumpIf(0x83, slow);                // jae slow, the stack must grow
+        stackAddress();
+        guardNotBoxed(0, slow);
+
+        storeValue(value, 0);
+        emit({ 0x48, 0xff, 0xc0 });        // inc rax
+        emit({ 0x48, 0x89 });              // mov [rbx + sp], rax
+        memory(rax, rbx, m_layout.sp);
+    }
+
+    void NativeAssembler::numberOperator(NativeOperator op, const NativeValue& true_value, const NativeValue& false_value, std::size_t slow)
+    {
+        emit({ 0x48, 0x8b });              // mov rax, [rbx + sp]
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x48, 0x89, 0xc2 });        // mov rdx, rax
+        emit({ 0x48, 0x2b });              // sub rdx, [rbx + fp]
+        memory(rdx, rbx, m_layout.fp);
+        emit({ 0x48, 0x83, 0xfa, 0x02 });  // cmp rdx, 2
+        jumpIf(0x82, slow);                // jb slow
+        stackAddress();
+        emit({ 0x80, 0x79, 0xe8, m_layout.number_type });  // cmp byte [rcx - 24], number
+        jumpIf(0x85, slow);
+        emit({ 0x80, 0x79, 0xf8, m_layout.number_type });  // cmp byte [rcx - 8], number
+        jumpIf(0x85, slow);
+        emit({ 0xf2, 0x0f, 0x10, 0x41, 0xe0 });  // movsd xmm0, [rcx - 32]
+        emit({ 0xf2, 0x0f, 0x10, 0x49, 0xf0 });  // movsd xmm1, [rcx - 16]
+
+        if (op == NativeOperator::Add || op == NativeOperator::Sub || op == NativeOperator::Mul || op == NativeOperator::Div)
+        {
+            if (op == NativeOperator::Add)
+                emit({ 0xf2, 0x0f, 0x58, 0xc1 });  // addsd xmm0, xmm1
+            else if (op == NativeOperator::Sub)
+                emit({ 0xf2, 0x0f, 0x5c, 0xc1 });  // subsd xmm0, xmm1
+            else if (op == NativeOperator::Mul)
+                emit({ 0xf2, 0x0f, 0x59, 0xc1 });  // mulsd xmm0, xmm1
+            else
+            {
+                // the helper raises the division by zero (a NaN divisor takes the slow path too)
+                emit({ 0x66, 0x0f, 0x57, 0xd2 });  // xorpd xmm2, xmm2
+                emit({ 0x66, 0x0f, 0x2e, 0xca });  // ucomisd xmm1, xmm2
+                jumpIf(0x84, slow);                // je slow
+                emit({ 0xf2, 0x0f, 0x5e, 0xc1 });  // divsd xmm0, xmm1
+            }
+            emit({ 0xf2, 0x0f, 0x11, 0x41, 0xe0 });  // movsd [rcx - 32], xmm0
+            emit({ 0x66, 0xc7, 0x41, 0xe8, m_layout.number_type, 0x00 });  // mov word [rcx - 24], number
+        }
+        else
+        {
+            // the comparisons are false when a number is NaN, as in C++
+            const std::size_t is_true = newLabel();
+            const std::size_t is_false = newLabel();
+            const std::size_t done = newLabel();
+
+            if (op == NativeOperator::Lt || op == NativeOperator::Le)
+                emit({ 0x66, 0x0f, 0x2e, 0xc8 });  // ucomisd xmm1, xmm0
+            else
+                emit({ 0x66, 0x0f, 0x2e, 0xc1 });  // ucomisd xmm0, xmm1
+
+            if (op == NativeOperator::Gt || op == NativeOperator::Lt)
+                jumpIf(0x87, is_true);             // ja
+            else if (op == NativeOperator::Ge || op == NativeOperator::Le)
+                jumpIf(0x83, is_true);             // jae
+            else if (op == NativeOperator::Eq)
+            {
+                jumpIf(0x85, is_false);            // jne
+                jumpIf(0x8b, is_true);             // jnp
+            }
+            else
+            {
+                jumpIf(0x85, is_true);             // jne
+                jumpIf(0x8a, is_true);             // jp
+            }
+
+            bindLabel(is_false);
+            storeValue(false_value, -32);
+            jump(done);
+            bindLabel(is_true);
+            storeValue(true_value, -32);
+            bindLabel(done);
+        }
+
+        emit({ 0x48, 0xff, 0xc8 });        // dec rax
+        emit({ 0x48, 0x89 });              // mov [rbx + sp], rax
+        memory(rax, rbx, m_layout.sp);
+    }
+
+    void NativeAssembler::popJumpIf(const NativeValue& value, std::size_t target, std::size_t slow)
+    {
+        emit({ 0x48, 0x8b });              // mov rax, [rbx + sp]
+        memory(rax, rbx, m_layout.sp);
+        emit({ 0x48, 0x3b });              // cmp rax, [rbx + fp]
+        memory(rax, rbx, m_layout.fp);
+        jumpIf(0x86, slow);                // jbe slow, nothing to pop in this frame
+        emit({ 0x48, 0xff, 0xc8 });        // dec rax
+        emit({ 0x48, 0x89 });              // mov [rbx + sp], rax
+        memory(rax, rbx, m_layout.sp);
+        stackAddress();
+
+        // the popped value stays in the stack, as with the interpreter: only its type and its NFT are compared
+        const std::size_t next = newLabel();
+        emit({ 0x80, 0x79, 0x08, static_cast<uint8_t>(value.tag) });  // cmp byte [rcx + 8], type
+        jumpIf(0x85, next);                // jne next
+        emit({ 0x81, 0x39 });              // cmp dword [rcx], nft
+        emit32(static_cast<uint32_t>(value.payload));
+        jumpIf(0x84, target);              // je target
+        bindLabel(next);
+    }
+
+    void NativeAssembler::callHelper(NativeHelper helper, int ip, int page)
+    {
+        emit({ 0x48, 0x89, 0xdf });        // mov rdi, rbx
+        emit({ 0xbe });                    // mov esi, ip
+        emit32(static_cast<uint32_t>(ip));
+        emit({ 0xba });                    // mov edx, page
+        emit32(static_cast<uint32_t>(page));
+        emit({ 0x48, 0xb8 });              // mov rax, helper
+        emit64(reinterpret_cast<uint64_t>(helper));
+        emit({ 0xff, 0xd0 });              // call rax
+    }
+
+    void NativeAssembler::jumpIfEqual(int value, std::size_t target)
+    {
+        emit({ 0x3d });                    // cmp eax, value
+        emit32(static_cast<uint32_t>(value));
+        emit({ 0x0f, 0x84 });              // je target
+        emitRel32(target);
+    }
+
+    void NativeAssembler::dispatchUnless(int value)
+    {
+        emit({ 0x3d });                    // cmp eax, value
+        emit32(static_cast<uint32_t>(value));
+        emit({ 0x0f, 0x85 });              // jne dispatch
+        emitRel32(DispatchLabel);
+    }
+
+    void NativeAssembler::dispatch()
+    {
+        emit({ 0xe9 });                    // jmp dispatch
+        emitRel32(DispatchLabel);
+    }
+
+    void NativeAssembler::jump(std::size_t target)
+    {
+        emit({ 0xe9 });                    // jmp target
+        emitRel32(target);
+    }
+
+    std::vector<uint8_t> NativeAssembler::finalize()
+    {
+        for (const Fixup& fixup : m_fixups)
+            patch32(fixup.position, static_cast<uint32_t>(
+                static_cast<int32_t>(labelOffset(fixup.label)) - static_cast<int32_t>(fixup.position + 4)
+            ));
+
+        while (m_code.size() % 4 != 0)
+            emit({ 0xcc });                // int3, never run
+        patch32(m_table_disp, static_cast<uint32_t>(m_code.size()));
+        for (std::size_t i=0; i <= m_instructions; ++i)
+            emit32(static_cast<uint32_t>(m_labels[i]));
+
+        return std::move(m_code);
+    }
+
+    void NativeAssembler::emit(std::initializer_list<uint8_t> bytes)
+    {
+        m_code.insert(m_code.end(), bytes);
+    }
+
+    void NativeAssembler::emit32(uint32_t value)
+    {
+        for (int i=0; i < 4; ++i)
+            m_code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void NativeAssembler::emit64(uint64_t value)
+    {
+        for (int i=0; i < 8; ++i)
+            m_code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void NativeAssembler::patch32(std::size_t position, uint32_t value)
+    {
+        for (int i=0; i < 4; ++i)
+            m_code[position + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    void NativeAssembler::memory(uint8_t reg, uint8_t base, int32_t disp)
+    {
+        emit({ static_cast<uint8_t>(0x80 | (reg << 3) | base) });  // mod 10, no SIB: base isn't rsp
+        emit32(static_cast<uint32_t>(disp));
+    }
+
+    void NativeAssembler::jumpIf(uint8_t condition, std::size_t label)
+    {
+        emit({ 0x0f, condition });
+        emitRel32(label);
+    }
+
+    void NativeAssembler::stackAddress()
+    {
+        emit({ 0x48, 0x89, 0xc1 });        // mov rcx, rax
+        emit({ 0x48, 0xc1, 0xe1, 0x04 });  // shl rcx, 4, a value being 16 bytes
+        emit({ 0x48, 0x03 });              // add rcx, [rbx + stack]
+        memory(rcx, rbx, m_layout.stack);
+    }
+
+    void NativeAssembler::guardNotBoxed(int8_t offset, std::size_t slow)
+    {
+        emit({ 0x0f, 0xb6, 0x51, static_cast<uint8_t>(offset + 8) });  // movzx edx, byte [rcx + offset + 8]
+        emit({ 0xbf });                    // mov edi, unboxed types
+        emit32(m_layout.unboxed_types);
+        emit({ 0x0f, 0xa3, 0xd7 });        // bt edi, edx
+        jumpIf(0x83, slow);                // jnc slow
+    }
+
+    void NativeAssembler::storeValue(const NativeValue& value, int8_t offset)
+    {
+        emit({ 0x48, 0xba });              // mov rdx, payload
+        emit64(value.payload);
+        emit({ 0x48, 0x89, 0x51, static_cast<uint8_t>(offset) });  // mov [rcx + offset], rdx
+        emit({ 0x48, 0xba });              // mov rdx, tag
+        emit64(value.tag);
+        emit({ 0x48, 0x89, 0x51, static_cast<uint8_t>(offset + 8) });  // mov [rcx + offset + 8], rdx
+    }
+
+    void NativeAssembler::emitRel32(std::size_t label)
+    {
+        m_fixups.push_back({ m_code.size(), label });
+        emit32(0);
+    }
+
+    std::size_t NativeAssembler::labelOffset(std::size_t label)
+    {
+        if (label == DispatchLabel)
+            return m_dispatch;
+        else if (label == ExitLabel || label >= m_labels.size())
+            return m_exit;
+        return m_labels[label];
+    }
+}
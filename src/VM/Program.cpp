@@ -0,0 +1,349 @@
+#include <Ark/VM/Program.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <Ark/Compiler/Instructions.hpp>
+#include <Ark/Constants.hpp>
+#include <Ark/Utils.hpp>
+#include <Ark/Log.hpp>
+
+namespace Ark
+{
+    Program::Program(const bytecode_t& bytecode, const std::string& filename, uint16_t features, bool debug) :
+        m_filename(filename), m_debug(debug), m_superinstructions_count(0)
+    {
+        load(bytecode, features);
+    }
+
+    void Program::load(const bytecode_t& bytecode, uint16_t features)
+    {
+        using namespace Ark::internal;
+
+        // read the tables and decode the pages
+        const bytecode_t& b = bytecode;
+        std::size_t i = 0;
+
+        auto readNumber = [&b] (std::size_t& i) -> uint16_t {
+            uint16_t x = (static_cast<uint16_t>(b[i]) << 8); ++i;
+            uint16_t y = static_cast<uint16_t>(b[i]);
+            return x + y;
+        };
+
+        // read tables and check if bytecode is valid
+        if (!(b.size() > 4 && b[i++] == 'a' && b[i++] == 'r' && b[i++] == 'k' && b[i++] == Instruction::NOP))
+            throwVMError("invalid format: couldn't find magic constant");
+
+        if (m_debug)
+            Ark::logger.info("(Program) magic constant found: ark\\0");
+
+        uint16_t major = readNumber(i); i++;
+        uint16_t minor = readNumber(i); i++;
+        uint16_t patch = readNumber(i); i++;
+
+        if (m_debug)
+            Ark::logger.info("(Program) version used: ", major, ".", minor, ".", patch);
+        
+        // the format of the bytecode changes with the minor versions
+        if (major != ARK_VERSION_MAJOR || minor != ARK_VERSION_MINOR)
+        {
+            std::string str_version = Ark::Utils::toString(major) + "." +
+                Ark::Utils::toString(minor) + "." +
+                Ark::Utils::toString(patch);
+            std::string builtin_version = Ark::Utils::toString(ARK_VERSION_MAJOR) + "." +
+                Ark::Utils::toString(ARK_VERSION_MINOR) + "." +
+                Ark::Utils::toString(ARK_VERSION_PATCH);
+            throwVMError("Compiler and VM versions don't match: " + str_version + " and " + builtin_version);
+        }
+
+        using timestamp_t = unsigned long long;
+        timestamp_t timestamp = 0;
+        auto aa = (static_cast<timestamp_t>(b[  i]) << 56),
+            ba = (static_cast<timestamp_t>(b[++i]) << 48),
+            ca = (static_cast<timestamp_t>(b[++i]) << 40),
+            da = (static_cast<timestamp_t>(b[++i]) << 32),
+            ea = (static_cast<timestamp_t>(b[++i]) << 24),
+            fa = (static_cast<timestamp_t>(b[++i]) << 16),
+            ga = (static_cast<timestamp_t>(b[++i]) <<  8),
+            ha = (static_cast<timestamp_t>(b[++i]));
+        i++;
+        timestamp = aa + ba + ca + da + ea + fa + ga + ha;
+
+        if (m_debug)
+            Ark::logger.info("(Program) timestamp: ", timestamp);
+
+        if (b[i] == Instruction::SYM_TABLE_START)
+        {
+            if (m_debug)
+                Ark::logger.info("(Program) symbols table");
+            
+            i++;
+            uint16_t size = readNumber(i);
+            m_symbols.reserve(size);
+            i++;
+
+            if (m_debug)
+                Ark::logger.info("(Program) length:", size);
+            
+            for (uint16_t j=0; j < size; ++j)
+            {
+                std::string symbol = "";
+                while (b[i] != 0)
+                    symbol.push_back(b[i++]);
+                i++;
+
+                m_symbols.push_back(symbol);
+
+                if (m_debug)
+                    Ark::logger.info("(Program) -", symbol);
+            }
+        }
+        else
+            throwVMError("couldn't find symbols table");
+
+        if (b[i] == Instruction::VAL_TABLE_START)
+        {
+            if (m_debug)
+                Ark::logger.info("(Program) constants table");
+            
+            i++;
+            uint16_t size = readNumber(i);
+            m_constants.reserve(size);
+            i++;
+
+            if (m_debug)
+                Ark::logger.info("(Program) length:", size);
+
+            for (uint16_t j=0; j < size; ++j)
+            {
+                uint8_t type = b[i];
+                i++;
+
+                if (type == Instruction::NUMBER_TYPE)
+                {
+                    std::string val = "";
+                    while (b[i] != 0)
+                        val.push_back(b[i++]);
+                    i++;
+
+                    m_constants.emplace_back(std::stod(val));
+                    
+                    if (m_debug)
+                        Ark::logger.info("(Program) - (Number)", val);
+                }
+                else if (type == Instruction::STRING_TYPE)
+                {
+                    std::string val = "";
+                    while (b[i] != 0)
+                        val.push_back(b[i++]);
+                    i++;
+
+                    m_constants.emplace_back(val);
+                    
+                    if (m_debug)
+                        Ark::logger.info("(Program) - (String)", val);
+                }
+                else if (type == Instruction::FUNC_TYPE)
+                {
+                    uint16_t addr = readNumber(i);
+                    i++;
+
+                    m_constants.emplace_back(addr);
+
+                    if (m_debug)
+                        Ark::logger.info("(Program) - (PageAddr)", addr);
+                    
+                    i++;  // skip NOP
+                }
+                else
+                    throwVMError("unknown value type for value " + Ark::Utils::toString(j));
+            }
+        }
+        else
+            throwVMError("couldn't find constants table");
+
+        if (b[i] == Instruction::PLUGIN_TABLE_START)
+        {
+            if (m_debug)
+                Ark::logger.info("(Program) plugins table");
+            
+            i++;
+            uint16_t size = readNumber(i);
+            m_plugins.reserve(size);
+            i++;
+
+            if (m_debug)
+                Ark::logger.info("(Program) length:", size);
+            
+            for (uint16_t j=0; j < size; ++j)
+            {
+                std::string plugin = "";
+                while (b[i] != 0)
+                    plugin.push_back(b[i++]);
+                i++;
+
+                m_plugins.push_back(plugin);
+
+                if (m_debug)
+                    Ark::logger.info("(Program) -", plugin);
+            }
+        }
+        else
+            throwVMError("couldn't find plugins table");
+        
+        while (b[i] == Instruction::CODE_SEGMENT_START)
+        {
+            if (m_debug)
+                Ark::logger.info("(Program) code segment");
+            
+            i++;
+            // symbols declared by the page, they get a slot in the scopes created for it
+            uint16_t layout_size = readNumber(i);
+            i++;
+            m_scope_layouts.emplace_back();
+            m_scope_layouts.back().reserve(layout_size);
+            for (uint16_t j=0; j < layout_size; ++j)
+            {
+                uint16_t id = readNumber(i);
+                i++;
+                if (id >= m_symbols.size())
+                    throwVMError("invalid symbol id in the scope of pp: " + Ark::Utils::toString(m_pages.size()));
+                m_scope_layouts.back().push_back(id);
+            }
+
+            uint16_t size = readNumber(i);
+            i++;
+
+            if (m_debug)
+                Ark::logger.info("(Program) length:", size);
+            
+            m_pages.emplace_back();
+            m_pages.back().reserve(size);
+            m_addresses.emplace_back();
+            m_addresses.back().reserve(size);
+
+            // decode the instructions once, so that the operands aren't read byte by byte
+            // at each execution. Jump targets are byte addresses in the bytecode, they are
+            // converted to indices in the decoded page
+            std::vector<uint16_t> index_of_address(size + 1, static_cast<uint16_t>(~0));
+            std::size_t page_end = i + size;
+
+            while (i < page_end)
+            {
+                index_of_address[size - (page_end - i)] = static_cast<uint16_t>(m_pages.back().size());
+                m_addresses.back().push_back(static_cast<uint16_t>(size - (page_end - i)));
+                uint8_t inst = b[i]; i++;
+
+                if (!isDecodable(inst))
+                    throwVMError("unknown instruction: " + Ark::Utils::toString(static_cast<std::size_t>(inst)) +
+                        ", pp: " + Ark::Utils::toString(m_pages.size() - 1) + ", address: " + Ark::Utils::toString(size - (page_end - i) - 1));
+
+                uint16_t arg = 0;
+                if (hasArgument(inst))
+                {
+                    if (i + 1 >= page_end)
+                        throwVMError("missing argument for instruction at address " + Ark::Utils::toString(size - (page_end - i) - 1) +
+                            ", pp: " + Ark::Utils::toString(m_pages.size() - 1));
+                    arg = readNumber(i); i++;
+                }
+
+                m_pages.back().push_back({ inst, arg });
+            }
+            index_of_address[size] = static_cast<uint16_t>(m_pages.back().size());
+
+            for (auto& inst : m_pages.back())
+            {
+                if (inst.inst == Instruction::JUMP || inst.inst == Instruction::POP_JUMP_IF_TRUE || inst.inst == Instruction::POP_JUMP_IF_FALSE)
+                {
+                    if (inst.arg > size || index_of_address[inst.arg] == static_cast<uint16_t>(~0))
+                        throwVMError("invalid jump target: " + Ark::Utils::toString(inst.arg) +
+                            ", pp: " + Ark::Utils::toString(m_pages.size() - 1));
+                    inst.arg = index_of_address[inst.arg];
+                }
+                else if (inst.inst == Instruction::LOAD_LOCAL || inst.inst == Instruction::STORE_LOCAL ||
+                    inst.inst == Instruction::LOAD_GLOBAL)
+                {
+                    if (inst.arg >= m_symbols.size())
+                        throwVMError("invalid symbol id: " + Ark::Utils::toString(inst.arg) +
+                            ", pp: " + Ark::Utils::toString(m_pages.size() - 1));
+
+                    // locals are read by their slot in the scope. The global scope has a slot
+                    // for each symbol, thus the slot of a global is its symbol id
+                    if (inst.inst != Instruction::LOAD_GLOBAL && m_pages.size() > 1)
+                    {
+                        const auto& layout = m_scope_layouts.back();
+                        auto it = std::find(layout.begin(), layout.end(), inst.arg);
+                        if (it == layout.end())
+                            throwVMError("symbol " + m_symbols[inst.arg] + " isn't declared in the scope of pp: " +
+                                Ark::Utils::toString(m_pages.size() - 1));
+                        inst.arg = static_cast<uint16_t>(std::distance(layout.begin(), it));
+                    }
+                }
+            }
+
+            if (features & FeatureSuperinstructions)
+                fuseInstructions(m_pages.back());
+            
+            if (i == b.size())
+                break;
+        }
+    }
+
+    void Program::fuseInstructions(std::vector<internal::DecodedInst>& page)
+    {
+        using namespace Ark::internal;
+
+        /*
+            Only the first instruction of a sequence is replaced, thus the jump targets
+            (indices in the page) stay valid. The sequences were chosen by running
+            `Ark --opcode-stats` on the examples, the tests and the standard library
+        */
+        for (std::size_t i=0, end=page.size(); i + 1 < end; ++i)
+        {
+            uint8_t first = page[i].inst, second = page[i + 1].inst;
+            uint8_t fused = Instruction::NOP;
+
+            if (first == Instruction::LOAD_LOCAL && second == Instruction::LOAD_CONST && i + 2 < end &&
+                Instruction::ADD <= page[i + 2].inst && page[i + 2].inst <= Instruction::EQ)
+                fused = Instruction::LOAD_LOCAL_LOAD_CONST_ADD + (page[i + 2].inst - Instruction::ADD);
+            else if (second == Instruction::CALL)
+            {
+                if (first == Instruction::LOAD_GLOBAL)
+                    fused = Instruction::LOAD_GLOBAL_CALL;
+                else if (first == Instruction::LOAD_LOCAL)
+                    fused = Instruction::LOAD_LOCAL_CALL;
+                else if (first == Instruction::BUILTIN)
+                    fused = Instruction::BUILTIN_CALL;
+            }
+            else if (first == Instruction::LOAD_GLOBAL && second == Instruction::TAIL_CALL)
+                fused = Instruction::LOAD_GLOBAL_TAIL_CALL;
+
+            if (fused != Instruction::NOP)
+            {
+                page[i].inst = fused;
+                ++m_superinstructions_count;
+            }
+        }
+    }
+
+    bool Program::isDecodable(uint8_t inst)
+    {
+        return inst == internal::Instruction::NOP ||
+            (internal::Instruction::FIRST_COMMAND <= inst && inst <= internal::Instruction::LAST_COMMAND) ||
+            (internal::Instruction::FIRST_OPERATOR <= inst && inst <= internal::Instruction::LAST_OPERATOR);
+    }
+
+    bool Program::hasArgument(uint8_t inst)
+    {
+        using namespace Ark::internal;
+
+        return FIRST_COMMAND <= inst && inst <= LAST_COMMAND &&
+            inst != Instruction::RET && inst != Instruction::HALT && inst != Instruction::SAVE_ENV &&
+            inst != Instruction::GENERATOR;
+    }
+
+    void Program::throwVMError(const std::string& message)
+    {
+        throw std::runtime_error("VMError: " + message);
+    }
+}
@@ -0,0 +1,22 @@
+#include <Ark/VM/Scope.hpp>
+
+namespace Ark::internal
+{
+    Scope::Scope()
+    {}
+
+    Scope::Scope(const std::vector<uint16_t>& layout)
+    {
+        // keep room for the variables registered at call time (function name)
+        m_data.reserve(layout.size() + 1);
+        for (uint16_t id : layout)
+            m_data.emplace_back(id, Value());
+    }
+
+    Scope::Scope(std::size_t symbols_count)
+    {
+        m_data.reserve(symbols_count);
+        for (std::size_t i=0; i < symbols_count; ++i)
+            m_data.emplace_back(static_cast<uint16_t>(i), Value());
+    }
+}
@@ -0,0 +1,88 @@
+#include <Ark/VM/Transfer.hpp>
+
+namespace Ark::internal
+{
+    Value Transfer::value(const Value& value)
+    {
+        Value copy;
+
+        switch (value.valueType())
+        {
+            case ValueType::String:
+                copy = Value(std::string(value.string_view()));
+                break;
+
+            case ValueType::List:
+            {
+                std::vector<Value> list;
+                list.reserve(value.const_list().size());
+                for (const Value& element : value.const_list())
+                    list.push_back(this->value(element));
+                copy = Value(std::move(list));
+                break;
+            }
+
+            case ValueType::Closure:
+                copy = Value(Closure(scope(*value.closure().scope()), value.closure().pageAddr()));
+                break;
+
+            case ValueType::Generator:
+            {
+                const Generator& generator = value.generator_ref();
+                auto it = m_generators.find(&generator);
+                if (it != m_generators.end())
+                    return it->second;
+
+                // registered before copying its stack, which can hold the generator itself
+                copy = Value(Generator({}, generator.m_page_addr, generator.m_ip));
+                m_generators.emplace(&generator, copy);
+
+                Generator& target = copy.generator_ref();
+                for (const Scope_t& generator_scope : generator.m_scopes)
+                    target.m_scopes.push_back(scope(*generator_scope));
+                target.m_stack.resize(generator.m_stack.size());
+                for (std::size_t i=0, end=generator.m_stack.size(); i < end; ++i)
+                    target.m_stack[i] = this->value(generator.m_stack[i]);
+                target.m_sp = generator.m_sp;
+                target.m_caller_sp = generator.m_caller_sp;
+                target.m_state = generator.m_state;
+                target.m_started = generator.m_started;
+                break;
+            }
+
+            case ValueType::StringBuilder:
+            {
+                auto it = m_builders.find(&value.builder_ref());
+                if (it != m_builders.end())
+                    return it->second;
+
+                copy = Value(ValueType::StringBuilder);
+                copy.builder_ref() = value.builder_ref();
+                m_builders.emplace(&value.builder_ref(), copy);
+                break;
+            }
+
+            default:
+                // stored inline, copying them doesn't touch a refcount
+                return value;
+        }
+
+        copy.setConst(value.isConst());
+        return copy;
+    }
+
+    Scope_t Transfer::scope(const Scope& scope)
+    {
+        auto it = m_scopes.find(&scope);
+        if (it != m_scopes.end())
+            return it->second;
+
+        // registered before copying its variables, which can reference the scope itself
+        Scope_t copy = makeRef<Scope>();
+        m_scopes.emplace(&scope, copy);
+
+        for (std::size_t i=0, end=scope.size(); i < end; ++i)
+            copy->push_back(scope.idOfSlot(i), value(scope.slot(i)));
+        return copy;
+    }
+}
@@ -0,0 +1,161 @@
+#include <Ark/VM/VMPool.hpp>
+
+#include <Ark/VM/VM.hpp>
+
+namespace Ark
+{
+    using namespace Ark::internal;
+
+    VMPool::VMPool(std::shared_ptr<const Program> program, std::size_t size, uint16_t features) :
+        m_program(std::move(program)), m_features(features), m_next(0), m_pending(0), m_stop(false)
+    {
+        if (size == 0)
+            size = std::max(1u, std::thread::hardware_concurrency());
+
+        for (std::size_t i=0; i < size; ++i)
+            m_workers.push_back(std::make_unique<Worker>());
+
+        std::vector<std::future<void>> started;
+        for (std::size_t i=0; i < size; ++i)
+        {
+            std::promise<void> promise;
+            started.push_back(promise.get_future());
+            m_threads.emplace_back(&VMPool::work, this, i, std::move(promise));
+        }
+
+        // the pool can't be used if the global code failed, its error is given to the caller
+        std::exception_ptr error;
+        for (auto& future : started)
+        {
+            try
+            {
+                future.get();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        if (error)
+        {
+            stop();
+            std::rethrow_exception(error);
+        }
+    }
+
+    VMPool::~VMPool()
+    {
+        stop();
+    }
+
+    void VMPool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_all();
+
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    std::future<Value> VMPool::call(const std::string& name, std::vector<Value> args)
+    {
+        // the worker gets a deep copy of the arguments, the refcounts of the values aren't atomic
+        Transfer transfer;
+        for (Value& arg : args)
+            arg = transfer.value(arg);
+        Job job { name, std::move(args), {} };
+        std::future<Value> result = job.result.get_future();
+
+        Worker& worker = *m_workers[m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_pending;
+        }
+        m_ready.notify_one();
+
+        return result;
+    }
+
+    void VMPool::work(std::size_t index, std::promise<void> started)
+    {
+        VM vm(/* persist */ false, m_features);
+        try
+        {
+            // unlike run(), start() gives the errors to the caller
+            vm.feed(m_program);
+            RunState state = vm.start();
+            while (state != RunState::Finished)
+                state = vm.resume();
+            vm.saveGlobals();
+            started.set_value();
+        }
+        catch (...)
+        {
+            started.set_exception(std::current_exception());
+            return;
+        }
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ready.wait(lock, [this] { return m_pending > 0 || m_stop; });
+                // stopping once all the jobs were taken
+                if (m_pending == 0)
+                    return;
+                --m_pending;
+            }
+
+            // a job is in a queue for each job counted as pending, we are sure to find ours
+            Job job;
+            while (!take(index, job))
+                std::this_thread::yield();
+
+            try
+            {
+                // the result can share objects with the VM, the caller gets a deep copy of it
+                Value result = Transfer().value(vm.callWithArguments(job.name, job.args));
+                vm.reset();
+                job.args.clear();
+                job.result.set_value(std::move(result));
+            }
+            catch (...)
+            {
+                vm.reset();
+                job.result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    bool VMPool::take(std::size_t index, Job& job)
+    {
+        for (std::size_t i=0, end=m_workers.size(); i < end; ++i)
+        {
+            Worker& worker = *m_workers[(index + i) % end];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+
+            if (!worker.jobs.empty())
+            {
+                if (i == 0)
+                {
+                    job = std::move(worker.jobs.front());
+                    worker.jobs.pop_front();
+                }
+                else
+                {
+                    job = std::move(worker.jobs.back());
+                    worker.jobs.pop_back();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+}
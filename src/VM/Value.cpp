@@ -1,68 +1,193 @@
 #include <Ark/VM/Value.hpp>
 
+#include <Ark/VM/Scope.hpp>
 #include <Ark/VM/Frame.hpp>
 #include <Ark/Utils.hpp>
 
 namespace Ark::internal
 {
+    String::String(std::string&& value) :
+        m_data(std::move(value)), m_parent(nullptr), m_offset(0), m_size(0)
+    {}
+
+    String::String(const String& other) :
+        m_parent(other.m_parent), m_offset(other.m_offset), m_size(other.m_size)
+    {
+        if (m_parent != nullptr)
+            ++m_parent->refcount;
+        else
+            m_data = other.m_data;
+    }
+
+    String::~String()
+    {
+        if (m_parent != nullptr && --m_parent->refcount == 0)
+            delete m_parent;
+    }
+
+    const std::string& String::str() const
+    {
+        if (m_parent != nullptr)
+        {
+            m_data.assign(view());
+            if (--m_parent->refcount == 0)
+                delete m_parent;
+            m_parent = nullptr;
+        }
+        return m_data;
+    }
+
+    std::string& String::str()
+    {
+        static_cast<const String&>(*this).str();
+        return m_data;
+    }
+
+    Box<String>* String::slice(const Box<String>* box, std::size_t offset, std::size_t size)
+    {
+        const String& string = box->data;
+
+        // the short slices fit in a std::string without allocating, they don't keep the characters of a long string alive
+        if (size <= std::string().capacity())
+            return new Box<String>(std::string(string.view().substr(offset, size)));
+
+        Box<String>* slice = new Box<String>();
+        if (string.m_parent != nullptr)
+        {
+            slice->data.m_parent = string.m_parent;
+            slice->data.m_offset = string.m_offset + offset;
+        }
+        else
+        {
+            slice->data.m_parent = const_cast<Box<String>*>(box);
+            slice->data.m_offset = offset;
+        }
+        slice->data.m_size = size;
+        ++slice->data.m_parent->refcount;
+        return slice;
+    }
+
+    // --------------------------
+
     Value::Value(ValueType type) :
         m_type(type), m_const(false)
     {
         if (m_type == ValueType::List)
-            m_value = std::vector<Value>();
+            m_value.box = new Box<List>();
+        else if (m_type == ValueType::String)
+            m_value.box = new Box<String>();
+        else if (m_type == ValueType::Closure)
+            m_value.box = new Box<Closure>();
+        else if (m_type == ValueType::StringBuilder)
+            m_value.box = new Box<std::string>();
+        else
+            m_value.number = 0;
     }
 
     Value::Value(int value) :
-        m_value(static_cast<double>(value)), m_type(ValueType::Number), m_const(false)
-    {}
+        m_type(ValueType::Number), m_const(false)
+    {
+        m_value.number = static_cast<double>(value);
+    }
 
     Value::Value(double value) :
-        m_value(value), m_type(ValueType::Number), m_const(false)
-    {}
+        m_type(ValueType::Number), m_const(false)
+    {
+        m_value.number = value;
+    }
 
     Value::Value(const std::string& value) :
-        m_value(value), m_type(ValueType::String), m_const(false)
-    {}
+        m_type(ValueType::String), m_const(false)
+    {
+        m_value.box = new Box<String>(std::string(value));
+    }
 
     Value::Value(std::string&& value) :
-        m_value(value), m_type(ValueType::String), m_const(false)
-    {}
+        m_type(ValueType::String), m_const(false)
+    {
+        m_value.box = new Box<String>(std::move(value));
+    }
+
+    Value::Value(const char* value) :
+        m_type(ValueType::String), m_const(false)
+    {
+        m_value.box = new Box<String>(std::string(value));
+    }
 
     Value::Value(PageAddr_t value) :
-        m_value(value), m_type(ValueType::PageAddr), m_const(false)
-    {}
+        m_type(ValueType::PageAddr), m_const(false)
+    {
+        m_value.page_addr = value;
+    }
 
     Value::Value(NFT value) :
-        m_value(value), m_type(ValueType::NFT), m_const(false)
-    {}
+        m_type(ValueType::NFT), m_const(false)
+    {
+        m_value.nft = value;
+    }
 
     Value::Value(Value::ProcType value) :
-        m_value(value), m_type(ValueType::CProc), m_const(false)
-    {}
+        m_type(ValueType::CProc), m_const(false)
+    {
+        m_value.proc = value;
+    }
 
     Value::Value(std::vector<Value>&& value) :
-        m_value(value), m_type(ValueType::List), m_const(false)
-    {}
+        m_type(ValueType::List), m_const(false)
+    {
+#ifdef ARK_PERSISTENT_LISTS
+        m_value.box = new Box<List>(std::make_move_iterator(value.begin()), std::make_move_iterator(value.end()));
+#else
+        m_value.box = new Box<List>(std::move(value));
+#endif
+    }
+
+#ifdef ARK_PERSISTENT_LISTS
+    Value::Value(List&& value) :
+        m_type(ValueType::List), m_const(false)
+    {
+        m_value.box = new Box<List>(std::move(value));
+    }
+#endif
 
     Value::Value(Closure&& value) :
-        m_value(value), m_type(ValueType::Closure), m_const(false)
-    {}
+        m_type(ValueType::Closure), m_const(false)
+    {
+        m_value.box = new Box<Closure>(std::move(value));
+    }
+
+    Value::Value(Generator&& value) :
+        m_type(ValueType::Generator), m_const(false)
+    {
+        m_value.box = new Box<Generator>(std::move(value));
+    }
 
     // --------------------------
 
-    std::vector<Value>& Value::list()
+    List& Value::list()
     {
-        return std::get<std::vector<Value>>(m_value);
+        detach();
+        return static_cast<Box<List>*>(m_value.box)->data;
     }
 
     Closure& Value::closure_ref()
     {
-        return std::get<Closure>(m_value);
+        detach();
+        return static_cast<Box<Closure>*>(m_value.box)->data;
     }
 
     std::string& Value::string_ref()
     {
-        return std::get<std::string>(m_value);
+        detach();
+        return static_cast<Box<String>*>(m_value.box)->data.str();
+    }
+
+    Value Value::slice(std::size_t offset, std::size_t size) const
+    {
+        Value value;
+        value.m_type = ValueType::String;
+        value.m_value.box = String::slice(static_cast<Box<String>*>(m_value.box), offset, size);
+        return value;
     }
 
     void Value::setConst(bool value)
@@ -74,10 +199,113 @@ namespace Ark::internal
 
     void Value::push_back(const Value& value)
     {
-        m_type = ValueType::List;
+        if (m_type != ValueType::List)
+            *this = Value(ValueType::List);
         list().push_back(value);
     }
 
+    void Value::push_back(Value&& value)
+    {
+        if (m_type != ValueType::List)
+            *this = Value(ValueType::List);
+        list().push_back(std::move(value));
+    }
+
+    // --------------------------
+
+    List dropFirst(const List& list)
+    {
+#ifdef ARK_PERSISTENT_LISTS
+        List tail(list);
+        tail.pop_front();
+        return tail;
+#else
+        return List(list.begin() + 1, list.end());
+#endif
+    }
+
+    void appendAll(List& list, const List& other)
+    {
+#ifdef ARK_PERSISTENT_LISTS
+        for (const Value& value : other)
+            list.push_back(value);
+#else
+        list.insert(list.end(), other.begin(), other.end());
+#endif
+    }
+
+    // --------------------------
+
+    void Value::destroy()
+    {
+        switch (m_type)
+        {
+            case ValueType::List:
+                delete static_cast<Box<List>*>(m_value.box);
+                break;
+
+            case ValueType::String:
+                delete static_cast<Box<String>*>(m_value.box);
+                break;
+
+            case ValueType::Closure:
+                delete static_cast<Box<Closure>*>(m_value.box);
+                break;
+
+            case ValueType::Generator:
+                delete static_cast<Box<Generator>*>(m_value.box);
+                break;
+
+            case ValueType::StringBuilder:
+                delete static_cast<Box<std::string>*>(m_value.box);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void Value::detach()
+    {
+        // copy on write: the box is duplicated only if someone else is using it
+        if (!isShared())
+            return;
+
+        BoxBase* copy = nullptr;
+        switch (m_type)
+        {
+            case ValueType::List:
+                copy = new Box<List>(static_cast<Box<List>*>(m_value.box)->data);
+                break;
+
+            case ValueType::String:
+                copy = new Box<String>(static_cast<Box<String>*>(m_value.box)->data);
+                break;
+
+            case ValueType::Closure:
+                copy = new Box<Closure>(static_cast<Box<Closure>*>(m_value.box)->data);
+                break;
+
+            default:
+                return;
+        }
+
+        release();
+        m_value.box = copy;
+    }
+
+    bool Value::boxedEqual(const Value& A, const Value& B)
+    {
+        switch (A.m_type)
+        {
+            case ValueType::List:    return A.const_list() == B.const_list();
+            case ValueType::String:  return A.string_view() == B.string_view();
+            case ValueType::Closure: return A.closure() == B.closure();
+            default:
+                return false;
+        }
+    }
+
     // --------------------------
 
     std::ostream& operator<<(std::ostream& os, const Value& V)
@@ -89,7 +317,7 @@ namespace Ark::internal
             break;
         
         case ValueType::String:
-            os << V.string();
+            os << V.string_view();
             break;
         
         case ValueType::PageAddr:
@@ -126,6 +354,14 @@ namespace Ark::internal
         case ValueType::Closure:
             os << "Closure @ " << V.closure().pageAddr();
             break;
+
+        case ValueType::Generator:
+            os << "Generator @ " << V.generator_ref().pageAddr();
+            break;
+
+        case ValueType::StringBuilder:
+            os << V.builder_ref();
+            break;
         
         default:
             os << "~\\._./~";
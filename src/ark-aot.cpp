@@ -0,0 +1,75 @@
+#include <iostream>
+#include <fstream>
+
+#include <clipp.hpp>
+#include <Ark/Utils.hpp>
+#include <Ark/Compiler/Compiler.hpp>
+#include <Ark/Compiler/BytecodeReader.hpp>
+#include <Ark/Compiler/CppGenerator.hpp>
+
+int main(int argc, char** argv)
+{
+    using namespace clipp;
+
+    std::string input = "", output = "";
+    bool help = false, plugin = false;
+
+    auto cli = (
+        option("-h", "--help").set(help).doc("Display this message")
+        | (
+            value("input", input).doc("ArkScript file, or bytecode file (.arkc), to compile to C++")
+            , option("-o", "--output").doc("Where to write the C++ code, the input file with a .cpp extension by default") & value("output", output)
+            , option("--plugin").set(plugin).doc("Generate a plugin giving the functions of the global scope to the VM loading it, instead of a program")
+        )
+    );
+
+    if (!parse(argc, argv, cli) || help || input.empty())
+    {
+        std::cerr << make_man_page(cli, argv[0]) << std::endl;
+        return help ? 0 : 1;
+    }
+    if (output.empty())
+        output = input.substr(0, input.find_last_of('.')) + ".cpp";
+
+    try {
+        Ark::bytecode_t bytecode;
+        if (input.size() > 5 && input.substr(input.size() - 5) == ".arkc")
+        {
+            Ark::BytecodeReader bcr;
+            bcr.feed(input);
+            bytecode = bcr.bytecode();
+        }
+        else
+        {
+            Ark::Compiler compiler;
+            compiler.feed(Ark::Utils::readFile(input), input);
+            compiler.compile();
+            bytecode = compiler.bytecode();
+        }
+
+        Ark::CppGenerator generator;
+        generator.feed(bytecode, input);
+        generator.generate(plugin);
+
+        std::ofstream file(output);
+        file << generator.code();
+        file.close();
+
+        std::cout << input << " -> " << output << "\n";
+        if (plugin)
+        {
+            std::cout << "  functions:";
+            for (const auto& name : generator.exportedFunctions())
+                std::cout << " " << name;
+            std::cout << "\n";
+        }
+        std::cout << "  build it against ArkReactor, for example:\n"
+            << "  c++ -std=c++17 -O2 " << (plugin ? "-shared -fPIC " : "") << "-I<Ark>/include -I<Ark>/thirdparty " << output
+            << " <build>/libArkReactor.a -ldl -o <" << (plugin ? "plugin.so" : "executable") << ">" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <fstream>
+
+#include <clipp.hpp>
+#include <Ark/Compiler/BytecodeReader.hpp>
+#include <Ark/Compiler/BytecodeOptimizer.hpp>
+
+int main(int argc, char** argv)
+{
+    using namespace clipp;
+
+    std::string input = "", output = "";
+    bool help = false;
+
+    auto cli = (
+        option("-h", "--help").set(help).doc("Display this message")
+        | (
+            value("input", input).doc("Bytecode file (.arkc) to optimize")
+            , option("-o", "--output").doc("Where to write the optimized bytecode, the input file by default") & value("output", output)
+        )
+    );
+
+    if (!parse(argc, argv, cli) || help || input.empty())
+    {
+        std::cerr << make_man_page(cli, argv[0]) << std::endl;
+        return help ? 0 : 1;
+    }
+    if (output.empty())
+        output = input;
+
+    try {
+        Ark::BytecodeReader bcr;
+        bcr.feed(input);
+
+        Ark::BytecodeOptimizer optimizer;
+        optimizer.feed(bcr.bytecode());
+        optimizer.optimize();
+
+        const Ark::bytecode_t& bytecode = optimizer.bytecode();
+        std::ofstream file(output, std::ofstream::binary);
+        file.write(reinterpret_cast<const char*>(bytecode.data()), bytecode.size());
+        file.close();
+
+        const auto& stats = optimizer.stats();
+        std::cout << input << ": " << bcr.bytecode().size() << " -> " << bytecode.size() << " bytes\n"
+            << "  jumps threaded: " << stats.jumps_threaded << ", jumps removed: " << stats.jumps_removed << "\n"
+            << "  NOP removed: " << stats.nops_removed << ", unreachable instructions removed: " << stats.unreachable_removed << "\n"
+            << "  constants removed: " << stats.constants_removed << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
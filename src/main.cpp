@@ -2,6 +2,9 @@
 
 #include <chrono>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 #include <clipp.hpp>
 #include <Ark/Ark.hpp>
@@ -17,26 +20,64 @@ void bcr(const std::string& file)
     }
 }
 
+void opcodeStats(const std::vector<std::string>& files)
+{
+    std::map<std::string, std::size_t> pairs, triples;
+
+    for (const auto& file : files)
+    {
+        try {
+            Ark::BytecodeReader bcr;
+            bcr.feed(file);
+            bcr.countSequences(pairs, triples);
+        } catch (const std::exception& e) {
+            std::cout << file << ": " << e.what() << std::endl;
+        }
+    }
+
+    auto display = [] (const std::string& title, const std::map<std::string, std::size_t>& counts) {
+        std::vector<std::pair<std::string, std::size_t>> sorted(counts.begin(), counts.end());
+        std::sort(sorted.begin(), sorted.end(), [] (const auto& a, const auto& b) {
+            return a.second > b.second;
+        });
+
+        std::cout << title << ":\n";
+        for (std::size_t i=0; i < sorted.size() && i < 20; ++i)
+            std::cout << "  " << sorted[i].second << "\t" << sorted[i].first << "\n";
+        std::cout << std::endl;
+    };
+
+    display("Pairs", pairs);
+    display("Triples", triples);
+}
+
 int main(int argc, char** argv)
 {
     using namespace clipp;
 
-    enum class mode { help, dev_info, bytecode_reader, version, run };
+    enum class mode { help, dev_info, bytecode_reader, opcode_stats, version, run };
     mode selected = mode::help;
 
     std::string file = "";
+    std::vector<std::string> files;
     bool debug = false;
+    bool jit = false;
     std::vector<std::string> wrong;
 
     auto cli = (
         option("-h", "--help").set(selected, mode::help).doc("Display this message")
         | option("--version").set(selected, mode::version).doc("Display ArkScript version and exit")
         | option("--dev-info").set(selected, mode::dev_info).doc("Display development information and exit")
+        | (
+            option("--opcode-stats").set(selected, mode::opcode_stats).doc("Count the most frequent sequences of instructions in the given bytecode files")
+            & values("files", files)
+        )
         | (
             value("file", file).set(selected, mode::run)
             , (
                 (
-                    option("-d", "--debug").set(debug).doc("Enable debug mode")
+                    option("-d", "--debug").set(debug).doc("Enable debug mode"),
+                    option("--jit").set(jit).doc("Compile the most called functions to native code (x86-64 Linux only)")
                 )
                 | option("-bcr", "--bytecode-reader").set(selected, mode::bytecode_reader).doc("Launch the bytecode reader")
             )
@@ -87,7 +128,7 @@ int main(int argc, char** argv)
                 }
                 else
                 {
-                    Ark::VM vm;
+                    Ark::VM vm(false, jit ? (Ark::DefaultFeatures | Ark::FeatureJIT) : Ark::DefaultFeatures);
                     vm.doFile(file);
                 }
                 break;
@@ -96,6 +137,10 @@ int main(int argc, char** argv)
             case mode::bytecode_reader:
                 bcr(file);
                 break;
+
+            case mode::opcode_stats:
+                opcodeStats(files);
+                break;
         }
     }
     else
@@ -0,0 +1,229 @@
+#include <Ark/VM/PersistentVector.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+
+using Ark::internal::PersistentVector;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what, int line)
+    {
+        if (!condition)
+        {
+            std::cerr << "persistent_vector.cpp:" << line << ": check failed: " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    // same elements, read by index and by the iterators
+    template <typename T>
+    bool same(const PersistentVector<T>& vector, const std::vector<T>& expected)
+    {
+        if (vector.size() != expected.size() || vector.empty() != expected.empty())
+            return false;
+
+        for (std::size_t i=0, end=expected.size(); i < end; ++i)
+        {
+            if (!(vector[i] == expected[i]))
+                return false;
+        }
+
+        std::size_t i = 0;
+        for (const T& value : vector)
+        {
+            if (!(value == expected[i++]))
+                return false;
+        }
+        return i == expected.size();
+    }
+
+    // the sizes around which the shape of the trie changes: the tail is full at 32 elements,
+    // the root gets a second level after 32 + 32 * 32 = 1056
+    const std::vector<std::size_t> boundaries { 0, 1, 31, 32, 33, 63, 64, 65, 1023, 1024, 1025, 1055, 1056, 1057, 1088, 1089, 2080, 2081 };
+
+    bool isBoundary(std::size_t size)
+    {
+        for (std::size_t boundary : boundaries)
+        {
+            if (size == boundary)
+                return true;
+        }
+        return false;
+    }
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// --------------------------------------------------
+
+void pushBack()
+{
+    PersistentVector<int> vector;
+    std::vector<int> expected;
+    std::vector<std::pair<PersistentVector<int>, std::vector<int>>> copies;
+
+    for (int i=0; i < 33000; ++i)
+    {
+        if (isBoundary(expected.size()))
+        {
+            CHECK(same(vector, expected));
+            copies.emplace_back(vector, expected);
+        }
+        vector.push_back(i);
+        expected.push_back(i);
+    }
+    CHECK(same(vector, expected));
+
+    // the copies taken on the way weren't modified by the elements pushed after them
+    for (const auto& [copy, copy_expected] : copies)
+        CHECK(same(copy, copy_expected));
+
+    // pushing on a copy doesn't modify the vector it shares its nodes with
+    for (auto& [copy, copy_expected] : copies)
+    {
+        const std::size_t size = copy.size();
+        for (int i=0; i < 40; ++i)
+        {
+            copy.push_back(-i);
+            copy_expected.push_back(-i);
+        }
+        CHECK(same(copy, copy_expected));
+        CHECK(vector[size] == static_cast<int>(size));
+    }
+    CHECK(same(vector, expected));
+}
+
+void popBack()
+{
+    std::vector<int> expected;
+    for (int i=0; i < 2100; ++i)
+        expected.push_back(i);
+    const PersistentVector<int> original(expected.begin(), expected.end());
+
+    // popped down to empty while sharing its nodes with the original, a copy being taken at each boundary
+    PersistentVector<int> vector(original);
+    std::vector<int> popped(expected);
+    std::vector<std::pair<PersistentVector<int>, std::vector<int>>> copies;
+    while (!popped.empty())
+    {
+        if (isBoundary(popped.size()))
+        {
+            CHECK(same(vector, popped));
+            copies.emplace_back(vector, popped);
+        }
+        vector.pop_back();
+        popped.pop_back();
+    }
+    CHECK(same(vector, popped));
+    CHECK(same(original, expected));
+    for (const auto& [copy, copy_expected] : copies)
+        CHECK(same(copy, copy_expected));
+
+    // growing again after a pop, on a shared vector: the slots popped are reused by this vector only
+    for (auto& [copy, copy_expected] : copies)
+    {
+        const PersistentVector<int> other(copy);
+        const std::vector<int> other_expected(copy_expected);
+        if (!copy.empty())
+        {
+            copy.pop_back();
+            copy_expected.pop_back();
+        }
+        copy.push_back(-1);
+        copy_expected.push_back(-1);
+        CHECK(same(copy, copy_expected));
+        CHECK(same(other, other_expected));
+    }
+    CHECK(same(original, expected));
+}
+
+void popFront()
+{
+    std::vector<int> expected;
+    for (int i=0; i < 2100; ++i)
+        expected.push_back(i);
+    const PersistentVector<int> original(expected.begin(), expected.end());
+
+    // the trie is rebuilt once more than half of the elements were dropped, the copies keeping theirs
+    PersistentVector<int> vector(original);
+    std::vector<int> popped(expected);
+    std::vector<std::pair<PersistentVector<int>, std::vector<int>>> copies;
+    while (!popped.empty())
+    {
+        if (isBoundary(popped.size()) || popped.size() % 97 == 0)
+        {
+            CHECK(same(vector, popped));
+            copies.emplace_back(vector, popped);
+        }
+        vector.pop_front();
+        popped.erase(popped.begin());
+    }
+    CHECK(same(vector, popped));
+    CHECK(same(original, expected));
+    for (const auto& [copy, copy_expected] : copies)
+        CHECK(same(copy, copy_expected));
+
+    // used as a queue, the elements being pushed at the back and popped at the front
+    for (auto& [copy, copy_expected] : copies)
+    {
+        for (int i=0; i < 100; ++i)
+        {
+            copy.push_back(i);
+            copy_expected.push_back(i);
+            copy.pop_front();
+            copy_expected.erase(copy_expected.begin());
+        }
+        CHECK(same(copy, copy_expected));
+    }
+    CHECK(same(original, expected));
+}
+
+void releases()
+{
+    // the elements are released when the last vector holding them drops them
+    auto element = std::make_shared<int>(1);
+    PersistentVector<std::shared_ptr<int>> vector;
+    for (int i=0; i < 1100; ++i)
+        vector.push_back(element);
+    CHECK(element.use_count() == 1101);
+
+    {
+        // shared: the elements popped by the copy are still held by the vector
+        PersistentVector<std::shared_ptr<int>> copy(vector);
+        for (int i=0; i < 100; ++i)
+            copy.pop_back();
+        CHECK(copy.size() == 1000 && vector.size() == 1100);
+        CHECK(element.use_count() == 1101);
+    }
+    CHECK(element.use_count() == 1101);
+
+    // owned alone: released right away
+    for (int i=0; i < 10; ++i)
+        vector.pop_back();
+    CHECK(element.use_count() == 1091);
+    vector.clear();
+    CHECK(element.use_count() == 1);
+}
+
+// --------------------------------------------------
+
+int main()
+{
+    pushBack();
+    popBack();
+    popFront();
+    releases();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
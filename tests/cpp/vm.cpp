@@ -0,0 +1,242 @@
+#include <Ark/Ark.hpp>
+
+#include <iostream>
+#include <string>
+#include <functional>
+
+using Ark::internal::Value;
+using Ark::RunState;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what, int line)
+    {
+        if (!condition)
+        {
+            std::cerr << "vm.cpp:" << line << ": check failed: " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    // true if the function throws
+    bool throws(const std::function<void()>& function)
+    {
+        try
+        {
+            function();
+        }
+        catch (const std::exception&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    Ark::bytecode_t compile(const std::string& code)
+    {
+        Ark::Compiler compiler;
+        compiler.feed(code);
+        compiler.compile();
+        return compiler.bytecode();
+    }
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// --------------------------------------------------
+
+void resumableRuns()
+{
+    const Ark::bytecode_t bytecode = compile(
+        "{\n"
+        "(mut i 0)\n"
+        "(while (< i 100) (set i (+ 1 i)))\n"
+        "(let sum (fun (n) {\n"
+        "    (mut total 0)\n"
+        "    (while (> n 0) {(set total (+ total n)) (set n (- n 1))})\n"
+        "    total }))\n"
+        "(let pauses (fun () {(yieldToHost) (yieldToHost) 3}))\n"
+        "(let pause yieldToHost)\n"
+        "(let pausesByValue (fun () {(pause) 4}))\n"
+        "(let fails (fun (n) {(while (> n 0) (set n (- n 1))) (+ n \"\")}))\n"
+        "}\n");
+
+    // the program is run by slices of 10 instructions
+    {
+        Ark::VM vm;
+        vm.feed(bytecode);
+
+        std::size_t slices = 1;
+        RunState state = vm.start(10);
+        while (state == RunState::OutOfBudget)
+        {
+            state = vm.resume(10);
+            ++slices;
+        }
+        CHECK(state == RunState::Finished);
+        CHECK(slices > 10);
+        CHECK(vm["i"].number() == 100);
+        CHECK(throws([&] { vm.resume(); }));
+    }
+
+    Ark::VM vm;
+    vm.feed(bytecode);
+    CHECK(vm.start() == RunState::Finished);
+
+    // same for a function, the result being the one of an uninterrupted call
+    {
+        CHECK(vm.startCall("sum", { Value(50) }, 1000) == RunState::Finished);
+        CHECK(vm.result().number() == 1275);
+
+        std::size_t slices = 1;
+        RunState state = vm.startCall("sum", { Value(50) }, 7);
+        while (state == RunState::OutOfBudget)
+        {
+            // a paused VM can't be given another call
+            if (slices == 1)
+                CHECK(throws([&] { vm.startCall("sum", { Value(1) }); }));
+            CHECK(throws([&] { vm.result(); }));
+
+            state = vm.resume(7);
+            ++slices;
+        }
+        CHECK(state == RunState::Finished);
+        CHECK(slices > 10);
+        CHECK(vm.result().number() == 1275);
+    }
+
+    // (yieldToHost) pauses the VM until it is resumed, with or without a budget
+    {
+        CHECK(vm.startCall("pauses", {}) == RunState::Yielded);
+        CHECK(vm.runState() == RunState::Yielded);
+        CHECK(vm.resume(1000) == RunState::Yielded);
+        CHECK(vm.resume() == RunState::Finished);
+        CHECK(vm.result().number() == 3);
+
+        // the builtin can be used as a value
+        CHECK(vm.startCall("pausesByValue", {}) == RunState::Yielded);
+        CHECK(vm.resume() == RunState::Finished);
+        CHECK(vm.result().number() == 4);
+    }
+
+    // an error resets the VM, which can be used again
+    {
+        auto run_fails = [&vm] {
+            if (vm.startCall("fails", { Value(10) }, 5) == RunState::OutOfBudget)
+                while (vm.resume(5) == RunState::OutOfBudget)
+                    ;
+        };
+        CHECK(throws(run_fails));
+        CHECK(vm.runState() == RunState::Finished);
+        CHECK(vm.startCall("sum", { Value(3) }, 5) == RunState::OutOfBudget);
+        while (vm.resume(5) == RunState::OutOfBudget)
+            ;
+        CHECK(vm.result().number() == 6);
+    }
+}
+
+// --------------------------------------------------
+
+void pools()
+{
+    const auto program = std::make_shared<const Ark::Program>(compile(
+        "{\n"
+        "(let make (fun (count) (fun (&count) {(set count (+ 1 count)) count})))\n"
+        "(let counter (make 0))\n"
+        "(let numbers (fun () {(mut i 0) (while true {(set i (+ 1 i)) (yield i)})}))\n"
+        "(let generator (numbers))\n"
+        "(let counters [(make 0)])\n"
+        "(mut calls 0)\n"
+        "(let next (fun () {(set calls (+ 1 calls)) (+ (* 1000 ((@ counters 0))) (* 100 calls) (* 10 (counter)) (generator))}))\n"
+        "(let fails (fun () (+ 1 \"\")))\n"
+        "}\n"));
+
+    // each job sees the global variables, the closures and the generators as they were after the global code
+    {
+        Ark::VMPool pool(program, 4);
+        std::vector<std::future<Value>> results;
+        for (int i=0; i < 200; ++i)
+            results.push_back(pool.call(i % 10 == 0 ? "fails" : "next"));
+
+        for (int i=0; i < 200; ++i)
+        {
+            if (i % 10 == 0)
+                CHECK(throws([&] { results[i].get(); }));
+            else
+                CHECK(results[i].get().number() == 1111);
+        }
+    }
+
+    // the error of the global code is given to the creator of the pool
+    {
+        const auto failing = std::make_shared<const Ark::Program>(compile("{(let a 1) (+ a \"\")}"));
+        CHECK(throws([&] { Ark::VMPool pool(failing, 2); }));
+    }
+}
+
+// --------------------------------------------------
+
+void cycles()
+{
+    Ark::VM vm;
+    vm.feed(compile(
+        "{\n"
+        "(let cycle (fun (n) {\n"
+        "    (mut self nil)\n"
+        "    (mut c (fun (v &self &n) (if (nil? v) n (set self v))))\n"
+        "    (c c)\n"
+        "    c }))\n"
+        "(let noCycle (fun (n) {\n"
+        "    (mut self nil)\n"
+        "    (mut c (fun (v &self &n) (if (nil? v) n (set self v))))\n"
+        "    (c 1)\n"
+        "    c }))\n"
+        "(let make (fun (function count) { (mut i 0) (while (< i count) { (function i) (set i (+ 1 i)) }) nil }))\n"
+        "(mut kept nil)\n"
+        "(let keep (fun (n) {(set kept (cycle n)) nil}))\n"
+        "(let keptValue (fun () (kept nil)))\n"
+        "}\n"));
+    vm.run();
+
+    const Ark::AllocationCounters& counters = vm.allocationCounters();
+    const std::size_t collections = counters.cycle_collections;
+
+    // the scopes captured by closures stored in them are freed by a collection, not the other ones
+    vm.call("make", vm["noCycle"], Value(100));
+    CHECK(vm.collectCycles() == 0);
+    vm.call("make", vm["cycle"], Value(100));
+    CHECK(vm.collectCycles() == 100);
+    CHECK(counters.cycle_collections == collections + 2);
+    CHECK(counters.scopes_reclaimed == 100);
+
+    // a cycle still referenced from outside of it stays alive
+    vm.call("keep", Value(42));
+    CHECK(vm.collectCycles() == 0);
+    CHECK(vm.call("keptValue").number() == 42);
+
+    // the collections are run automatically once enough scopes were captured. The values discarded
+    // by a function stay on the stack until it returns, its cycles can be freed only after that
+    for (int i=0; i < 30; ++i)
+        vm.call("make", vm["cycle"], Value(ARK_CYCLES_THRESHOLD / 10));
+    CHECK(counters.cycle_collections > collections + 3);
+    CHECK(counters.scopes_reclaimed >= 100 + 2 * ARK_CYCLES_THRESHOLD);
+}
+
+// --------------------------------------------------
+
+int main()
+{
+    resumableRuns();
+    pools();
+    cycles();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}